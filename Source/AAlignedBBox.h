@@ -91,9 +91,32 @@ class AAlignedBBox
             if (x.size() > y.size()) return x.size() > z.size() ? 0 : 2;
             else return y.size() > z.size() ? 1 : 2;
         }
+
+        /// @brief Proportional to the chance that a random ray hitting a surrounding box also hits this one.
+        float surfaceArea() const
+        {
+            return 2.0f * (x.size() * y.size() + y.size() * z.size() + z.size() * x.size());
+        }
 };
 
 
+/// @brief Box between a and b, at fraction t of the way from a to b along every bound.
+AAlignedBBox lerp(const AAlignedBBox& a, const AAlignedBBox& b, float t)
+{
+    auto lerpInterval = [t](const Interval& from, const Interval& to)
+    {
+        return Interval(from.min + t * (to.min - from.min), from.max + t * (to.max - from.max));
+    };
+
+    // Both boxes are already padded, so the result is at least as large as the smaller one on each axis.
+    AAlignedBBox result;
+    result.x = lerpInterval(a.x, b.x);
+    result.y = lerpInterval(a.y, b.y);
+    result.z = lerpInterval(a.z, b.z);
+
+    return result;
+}
+
 AAlignedBBox operator+(const AAlignedBBox& bbox, const Vector3& offset)
 {
     return AAlignedBBox(bbox.x + offset.x(), bbox.y + offset.y(), bbox.z + offset.z());
@@ -4,8 +4,25 @@
 #include "AAlignedBBox.h"
 #include "Hittable.h"
 #include "HittableList.h"
+#include "MappedFile.h"
 
 #include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+
+enum class BVHBuildMethod
+{
+    Median,         // sort along a random axis and split at the median
+    BinnedSAH,      // split where the surface area heuristic says, from binned centroids; subtrees build in parallel
+    SpatialSplits   // binned SAH that may also cut large objects at a plane and reference them from both sides
+};
 
 
 class BVHNode : public Hittable
@@ -14,12 +31,50 @@ class BVHNode : public Hittable
         shared_ptr<Hittable> left;
         shared_ptr<Hittable> right;
         AAlignedBBox bbox;
+        // Bounds at times 0 and 1; a moving node tests the box between them at the ray's time.
+        AAlignedBBox startBox;
+        AAlignedBBox endBox;
+        bool moving;
+        // Nodes of a tree loaded from the cache, owned by its root; they link to each other without ownership.
+        shared_ptr<BVHNode[]> nodeBlock;
+
+        static constexpr float movingAreaRatio = 1.25f;
+
+
+        /// @brief Box to test a ray against: the whole swept box for static subtrees, else the box at the ray's time.
+        AAlignedBBox boxAt(float time) const { return moving ? lerp(startBox, endBox, time) : bbox; }
+
+        /// @brief Recompute the node's bounds from those of its children.
+        void updateBounds()
+        {
+            setBounds(AAlignedBBox(left->boundingBox(), right->boundingBox()),
+                      AAlignedBBox(left->boundingBoxAt(0.0f), right->boundingBoxAt(0.0f)),
+                      AAlignedBBox(left->boundingBoxAt(1.0f), right->boundingBoxAt(1.0f)));
+        }
 
+        void setBounds(const AAlignedBBox& sweptBox, const AAlignedBBox& boxAtStart, const AAlignedBBox& boxAtEnd)
+        {
+            bbox = sweptBox;
+            startBox = boxAtStart;
+            endBox = boxAtEnd;
+
+            // Interpolating only pays when the swept box is clearly larger than the box at any single time,
+            // i.e. near the moving objects; nodes high up in the tree barely grow from the motion.
+            moving = bbox.surfaceArea() > movingAreaRatio * std::max(startBox.surfaceArea(), endBox.surfaceArea());
+        }
+
+        static float subtreeCost(const Hittable& child)
+        {
+            const BVHNode* node = dynamic_cast<const BVHNode*>(&child);
+
+            return node ? node->sahCost() : 1.0f;
+        }
         
         static bool boxCompare(const shared_ptr<Hittable> a, const shared_ptr<Hittable> b, int axisID)
         {
-            Interval axisIntervalA = a->boundingBox().axisInterval(axisID);
-            Interval axisIntervalB = b->boundingBox().axisInterval(axisID);
+            // Moving objects are sorted by where they are halfway through the exposure.
+            Interval axisIntervalA = a->boundingBoxAt(0.5f).axisInterval(axisID);
+            Interval axisIntervalB = b->boundingBoxAt(0.5f).axisInterval(axisID);
 
             return axisIntervalA.min < axisIntervalB.min;
         }
@@ -39,17 +94,626 @@ class BVHNode : public Hittable
             return boxCompare(a, b, 2);
         }
 
-    
-    public:
-        BVHNode(HittableList list) : BVHNode(list.hittableObjects, 0, list.hittableObjects.size()) {}
+        // An object as the SAH builder sees it: its bounds, computed once, and the centroid it is binned by.
+        struct BuildObject
+        {
+            AAlignedBBox bbox;
+            Point3 centroid;
+            shared_ptr<Hittable> object;
+        };
 
-        BVHNode(std::vector<shared_ptr<Hittable>>& hittableObjects, size_t start, size_t end)
+        struct Bin
+        {
+            AAlignedBBox bbox;
+            size_t count = 0;
+        };
+
+        using AxisBins = std::vector<Bin>;
+
+        static constexpr int binCount = 16;
+        // Ranges at least this large are binned by several threads at once, smaller ones by one thread.
+        static constexpr size_t parallelBinningSize = 1 << 16;
+        // Ranges at least this large hand their left subtree to a new thread while they build the right one.
+        static constexpr size_t parallelSubtreeSize = 1 << 12;
+
+
+        // Trees over at least cacheMinimumObjects objects are stored in cacheDirectory and reused when
+        // the same objects are built again. A cache file holds the tree's nodes in preorder, root
+        // first, each with its bounds and its children as a node index or, with objectReference set,
+        // an index into the list of objects it was built over. The file is named after a hash of the
+        // objects' bounds, so the stored bounds are only used for the same objects they came from.
+        struct FlatNode
+        {
+            uint32_t left;
+            uint32_t right;
+            uint32_t moving;
+            AAlignedBBox bbox;
+            AAlignedBBox startBox;
+            AAlignedBBox endBox;
+        };
+
+        struct CacheHeader
+        {
+            char     magic[4];
+            uint32_t version;
+            uint64_t inputHash;
+            uint64_t objectCount;
+            uint64_t nodeCount;
+        };
+
+        static constexpr char cacheMagic[4] = { 'R', 'T', 'B', 'V' };
+        static constexpr uint32_t cacheVersion = 2;
+        static_assert(std::is_trivially_copyable_v<FlatNode>, "cache nodes are written and mapped as raw bytes");
+        static constexpr uint32_t objectReference = 1u << 31;
+        static constexpr size_t cacheMinimumObjects = 1 << 14;
+
+
+        BVHNode() {}
+
+        /// @brief Hash of everything a cached tree depends on, in object order: the bounds the SAH builder
+        ///        splits by (the swept box and the box at mid-exposure) and the boxes at times 0 and 1,
+        ///        which the nodes' motion bounds and moving flags are computed from.
+        static uint64_t hashInputs(const std::vector<shared_ptr<Hittable>>& hittableObjects)
+        {
+            uint64_t hash = hashCombine(cacheVersion, hittableObjects.size());
+
+            auto hashBox = [&hash](const AAlignedBBox& bbox)
+            {
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    uint32_t bits[2];
+                    std::memcpy(&bits[0], &bbox.axisInterval(axis).min, sizeof(float));
+                    std::memcpy(&bits[1], &bbox.axisInterval(axis).max, sizeof(float));
+
+                    hash = hashCombine(hash, (uint64_t(bits[0]) << 32) | bits[1]);
+                }
+            };
+
+            for (const shared_ptr<Hittable>& hittableObject : hittableObjects)
+            {
+                hashBox(hittableObject->boundingBox());
+                hashBox(hittableObject->boundingBoxAt(0.0f));
+                hashBox(hittableObject->boundingBoxAt(0.5f));
+                hashBox(hittableObject->boundingBoxAt(1.0f));
+            }
+
+            return hash;
+        }
+
+        static std::string cacheFilename(uint64_t inputHash)
+        {
+            char name[32];
+            std::snprintf(name, sizeof(name), "%016llx.bvh", (unsigned long long)inputHash);
+
+            return (std::filesystem::path(cacheDirectory) / name).string();
+        }
+
+        /// @brief Append this node and the nodes below it to nodes, in preorder.
+        void flatten(const std::unordered_map<const Hittable*, uint32_t>& objectIDs, std::vector<FlatNode>& nodes) const
+        {
+            size_t index = nodes.size();
+            nodes.push_back({});
+
+            // The builder only puts the objects it was given and its own nodes into the tree.
+            auto childReference = [&](const shared_ptr<Hittable>& child)
+            {
+                auto found = objectIDs.find(child.get());
+
+                if (found != objectIDs.end())
+                    return found->second | objectReference;
+
+                uint32_t childIndex = uint32_t(nodes.size());
+                static_cast<const BVHNode&>(*child).flatten(objectIDs, nodes);
+
+                return childIndex;
+            };
+
+            uint32_t leftReference = childReference(left);
+            uint32_t rightReference = (right == left) ? leftReference : childReference(right);
+
+            nodes[index] = { leftReference, rightReference, moving, bbox, startBox, endBox };
+        }
+
+        /// @brief Rebuild the tree from its flattened nodes, with this node as the root. All other nodes
+        ///        share one allocation, laid out in preorder like the file and owned by the root alone.
+        /// @return false if the nodes do not form a valid tree over the objects.
+        bool unflatten(const FlatNode* nodes, size_t nodeCount, const std::vector<shared_ptr<Hittable>>& hittableObjects)
+        {
+            for (size_t index = 0; index < nodeCount; index++)
+                for (uint32_t reference : { nodes[index].left, nodes[index].right })
+                {
+                    // Children come after their parent in preorder, which also rules out cycles.
+                    bool valid = (reference & objectReference) ? (reference & ~objectReference) < hittableObjects.size()
+                                                               : reference > index && reference < nodeCount;
+
+                    if (!valid)
+                        return false;
+                }
+
+            nodeBlock.reset(new BVHNode[nodeCount]);
+
+            auto child = [&](uint32_t reference)
+            {
+                if (reference & objectReference)
+                    return hittableObjects[reference & ~objectReference];
+
+                // Sharing ownership of the block would make its nodes own themselves and never be freed.
+                return shared_ptr<Hittable>(shared_ptr<Hittable>(), &nodeBlock[reference]);
+            };
+
+            for (size_t index = 0; index < nodeCount; index++)
+            {
+                BVHNode& node = (index == 0) ? *this : nodeBlock[index];
+
+                node.left = child(nodes[index].left);
+                node.right = (nodes[index].right == nodes[index].left) ? node.left : child(nodes[index].right);
+                node.bbox = nodes[index].bbox;
+                node.startBox = nodes[index].startBox;
+                node.endBox = nodes[index].endBox;
+                node.moving = nodes[index].moving != 0;
+            }
+
+            return true;
+        }
+
+        /// @brief Map the cache file for these objects, if there is one, and rebuild the tree from it.
+        bool readCache(const std::vector<shared_ptr<Hittable>>& hittableObjects, uint64_t inputHash)
+        {
+            MappedFile file(cacheFilename(inputHash));
+
+            if (!file.isOpen() || file.size() < sizeof(CacheHeader))
+                return false;
+
+            CacheHeader header;
+            std::memcpy(&header, file.data(), sizeof(header));
+
+            if (std::memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0 || header.version != cacheVersion ||
+                header.inputHash != inputHash || header.objectCount != hittableObjects.size() || header.nodeCount == 0 ||
+                file.size() != sizeof(CacheHeader) + header.nodeCount * sizeof(FlatNode))
+                return false;
+
+            // The header is a multiple of the node alignment, so the nodes are used in place.
+            const FlatNode* nodes = reinterpret_cast<const FlatNode*>(file.data() + sizeof(CacheHeader));
+
+            return unflatten(nodes, header.nodeCount, hittableObjects);
+        }
+
+        /// @brief Store the tree for the next build over the same objects; failures are ignored.
+        void writeCache(const std::vector<shared_ptr<Hittable>>& hittableObjects, uint64_t inputHash) const
+        {
+            std::unordered_map<const Hittable*, uint32_t> objectIDs;
+
+            for (size_t objectID = 0; objectID < hittableObjects.size(); objectID++)
+                objectIDs.emplace(hittableObjects[objectID].get(), uint32_t(objectID));
+
+            std::vector<FlatNode> nodes;
+            flatten(objectIDs, nodes);
+
+            CacheHeader header;
+            std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+            header.version = cacheVersion;
+            header.inputHash = inputHash;
+            header.objectCount = hittableObjects.size();
+            header.nodeCount = nodes.size();
+
+            std::error_code error;
+            std::filesystem::create_directories(cacheDirectory, error);
+
+            // Write to a temporary file and rename it, so a concurrent reader never maps half a file.
+            std::string filename = cacheFilename(inputHash);
+            std::string temporaryFilename = filename + ".tmp";
+
+            {
+                std::ofstream out(temporaryFilename, std::ios::binary);
+
+                out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+                out.write(reinterpret_cast<const char*>(nodes.data()), nodes.size() * sizeof(FlatNode));
+
+                if (!out) return;
+            }
+
+            std::filesystem::rename(temporaryFilename, filename, error);
+        }
+
+        /// @brief Run work(chunkStart, chunkEnd, chunk) over [start, end) split into contiguous chunks,
+        ///        each on its own thread.
+        template <typename Work>
+        static void forChunks(size_t start, size_t end, int chunks, Work work)
+        {
+            size_t span = end - start;
+            std::vector<std::thread> threads;
+
+            for (int chunk = 1; chunk < chunks; chunk++)
+                threads.emplace_back(work, start + span * chunk / chunks, start + span * (chunk + 1) / chunks, chunk);
+
+            work(start, start + span / chunks, 0);
+
+            for (std::thread& thread : threads)
+                thread.join();
+        }
+
+        static int binIndex(float centroid, const Interval& centroidRange)
+        {
+            int bin = int(binCount * (centroid - centroidRange.min) / centroidRange.size());
+
+            return std::clamp(bin, 0, binCount - 1);
+        }
+
+        // Best split of a range of objects by the surface area heuristic: the objects whose centroid
+        // falls into bins 0..bin along axis go left. The boxes are those of the two sides.
+        struct ObjectSplit
+        {
+            int axis = -1;      // No split: all centroids coincide
+            int bin = 0;
+            float cost = infinity;
+            Interval centroidRange;
+            AAlignedBBox leftBox;
+            AAlignedBBox rightBox;
+
+            template <typename Object>
+            bool goesLeft(const Object& object) const { return binIndex(object.centroid[axis], centroidRange) <= bin; }
+        };
+
+        /// @brief Find the best split of objects[start, end) over binned centroids. Objects need a
+        ///        bbox and a centroid.
+        template <typename Object>
+        static ObjectSplit findObjectSplit(const std::vector<Object>& objects, size_t start, size_t end, int threads)
+        {
+            int chunks = (end - start >= parallelBinningSize) ? threads : 1;
+
+            std::vector<Interval> chunkRanges(3 * chunks);
+
+            forChunks(start, end, chunks, [&](size_t chunkStart, size_t chunkEnd, int chunk)
+            {
+                for (size_t i = chunkStart; i < chunkEnd; i++)
+                    for (int axis = 0; axis < 3; axis++)
+                        chunkRanges[3 * chunk + axis] = Interval(chunkRanges[3 * chunk + axis], Interval(objects[i].centroid[axis], objects[i].centroid[axis]));
+            });
+
+            Interval centroidRanges[3];
+
+            for (int chunk = 0; chunk < chunks; chunk++)
+                for (int axis = 0; axis < 3; axis++)
+                    centroidRanges[axis] = Interval(centroidRanges[axis], chunkRanges[3 * chunk + axis]);
+
+            std::vector<AxisBins> chunkBins(3 * chunks, AxisBins(binCount));
+
+            forChunks(start, end, chunks, [&](size_t chunkStart, size_t chunkEnd, int chunk)
+            {
+                for (size_t i = chunkStart; i < chunkEnd; i++)
+                    for (int axis = 0; axis < 3; axis++)
+                    {
+                        if (centroidRanges[axis].size() <= 0.0f)
+                            continue;
+
+                        Bin& bin = chunkBins[3 * chunk + axis][binIndex(objects[i].centroid[axis], centroidRanges[axis])];
+
+                        bin.bbox = AAlignedBBox(bin.bbox, objects[i].bbox);
+                        bin.count++;
+                    }
+            });
+
+            ObjectSplit best;
+
+            for (int axis = 0; axis < 3; axis++)
+            {
+                if (centroidRanges[axis].size() <= 0.0f)
+                    continue;
+
+                AxisBins bins(binCount);
+
+                for (int chunk = 0; chunk < chunks; chunk++)
+                    for (int b = 0; b < binCount; b++)
+                    {
+                        bins[b].bbox = AAlignedBBox(bins[b].bbox, chunkBins[3 * chunk + axis][b].bbox);
+                        bins[b].count += chunkBins[3 * chunk + axis][b].count;
+                    }
+
+                // Sweep from the right for the box and count right of each split, then from the left.
+                AAlignedBBox rightBoxes[binCount];
+                size_t rightCounts[binCount];
+                AAlignedBBox rightBox;
+                size_t rightCount = 0;
+
+                for (int b = binCount - 1; b > 0; b--)
+                {
+                    rightBox = AAlignedBBox(rightBox, bins[b].bbox);
+                    rightCount += bins[b].count;
+                    rightBoxes[b] = rightBox;
+                    rightCounts[b] = rightCount;
+                }
+
+                AAlignedBBox leftBox;
+                size_t leftCount = 0;
+
+                for (int b = 0; b < binCount - 1; b++)
+                {
+                    leftBox = AAlignedBBox(leftBox, bins[b].bbox);
+                    leftCount += bins[b].count;
+
+                    if (leftCount == 0 || rightCounts[b + 1] == 0)
+                        continue;
+
+                    float cost = leftCount * leftBox.surfaceArea() + rightCounts[b + 1] * rightBoxes[b + 1].surfaceArea();
+
+                    if (cost < best.cost)
+                    {
+                        best.axis = axis;
+                        best.bin = b;
+                        best.cost = cost;
+                        best.centroidRange = centroidRanges[axis];
+                        best.leftBox = leftBox;
+                        best.rightBox = rightBoxes[b + 1];
+                    }
+                }
+            }
+
+            return best;
+        }
+
+        /// @brief Choose a split of objects[start, end) by the surface area heuristic over binned
+        ///        centroids, and partition the range so that the left side comes first.
+        /// @return The index where the right side starts.
+        static size_t splitSAH(std::vector<BuildObject>& objects, size_t start, size_t end, int threads)
+        {
+            ObjectSplit split = findObjectSplit(objects, start, end, threads);
+
+            // All centroids coincide: any split is as good as another.
+            if (split.axis < 0)
+                return start + (end - start) / 2;
+
+            auto rightSide = std::partition(objects.begin() + start, objects.begin() + end, [&](const BuildObject& object)
+            {
+                return split.goesLeft(object);
+            });
+
+            return size_t(rightSide - objects.begin());
+        }
+
+        // A reference to an object for the spatial split builder. Objects cut by a split plane are
+        // referenced from both sides, each reference bounded by the part of the object on its side.
+        struct Reference
+        {
+            AAlignedBBox bbox;
+            AAlignedBBox startBox;
+            AAlignedBBox endBox;
+            Point3 centroid;
+            shared_ptr<Hittable> object;
+            bool splittable;
+        };
+
+        // A split plane along an axis for the spatial split builder.
+        struct SpatialSplit
+        {
+            int axis = -1;
+            float position = 0.0f;
+            float cost = infinity;
+        };
+
+        // Extra references the spatial split builder may still create, and the area overlaps are measured against.
+        struct SpatialSplitBudget
+        {
+            size_t remainingReferences;
+            float rootArea;
+        };
+
+        // Spatial splits are only tried where the sides of the best object split overlap by more than
+        // this fraction of the whole tree's surface area.
+        static constexpr float spatialSplitOverlap = 1e-5f;
+
+        static Point3 centerOf(const AAlignedBBox& bbox)
+        {
+            return 0.5f * Point3(bbox.x.min + bbox.x.max, bbox.y.min + bbox.y.max, bbox.z.min + bbox.z.max);
+        }
+
+        /// @brief The part of bbox within slab along axis.
+        static AAlignedBBox clip(const AAlignedBBox& bbox, int axis, const Interval& slab)
+        {
+            Interval intervals[3] = { bbox.x, bbox.y, bbox.z };
+            intervals[axis] = Interval(std::max(intervals[axis].min, slab.min), std::min(intervals[axis].max, slab.max));
+
+            return AAlignedBBox(intervals[0], intervals[1], intervals[2]);
+        }
+
+        static Reference clippedReference(const Reference& reference, int axis, const Interval& slab)
+        {
+            AAlignedBBox clipped = clip(reference.bbox, axis, slab);
+
+            return { clipped, clipped, clipped, centerOf(clipped), reference.object, true };
+        }
+
+        static float overlapArea(const AAlignedBBox& a, const AAlignedBBox& b)
+        {
+            float sizes[3];
+
+            for (int axis = 0; axis < 3; axis++)
+                sizes[axis] = std::min(a.axisInterval(axis).max, b.axisInterval(axis).max) -
+                              std::max(a.axisInterval(axis).min, b.axisInterval(axis).min);
+
+            if (sizes[0] <= 0.0f || sizes[1] <= 0.0f || sizes[2] <= 0.0f)
+                return 0.0f;
+
+            return 2.0f * (sizes[0] * sizes[1] + sizes[1] * sizes[2] + sizes[2] * sizes[0]);
+        }
+
+        /// @brief Find the best plane to cut the references at, by the surface area heuristic over bins
+        ///        of equal width across the node. A reference counts on every side it reaches into,
+        ///        with only the part of it on that side; one that cannot be split stays whole on the
+        ///        side of its centroid.
+        static SpatialSplit findSpatialSplit(const std::vector<Reference>& references, const AAlignedBBox& nodeBox)
+        {
+            SpatialSplit best;
+
+            for (int axis = 0; axis < 3; axis++)
+            {
+                const Interval& range = nodeBox.axisInterval(axis);
+                float binWidth = range.size() / binCount;
+
+                if (binWidth <= 0.0f)
+                    continue;
+
+                auto binOf = [&](float position) { return std::clamp(int((position - range.min) / binWidth), 0, binCount - 1); };
+
+                AAlignedBBox boxes[binCount];
+                size_t entries[binCount] = {};
+                size_t exits[binCount] = {};
+
+                for (const Reference& reference : references)
+                {
+                    const Interval& extent = reference.bbox.axisInterval(axis);
+                    int first = reference.splittable ? binOf(extent.min) : binOf(reference.centroid[axis]);
+                    int last = reference.splittable ? binOf(extent.max) : first;
+
+                    for (int b = first; b <= last; b++)
+                    {
+                        Interval slab(range.min + b * binWidth, range.min + (b + 1) * binWidth);
+                        AAlignedBBox part = reference.splittable ? clip(reference.bbox, axis, slab) : reference.bbox;
+
+                        boxes[b] = AAlignedBBox(boxes[b], part);
+                    }
+
+                    entries[first]++;
+                    exits[last]++;
+                }
+
+                AAlignedBBox rightBoxes[binCount];
+                size_t rightCounts[binCount];
+                AAlignedBBox rightBox;
+                size_t rightCount = 0;
+
+                for (int b = binCount - 1; b > 0; b--)
+                {
+                    rightBox = AAlignedBBox(rightBox, boxes[b]);
+                    rightCount += exits[b];
+                    rightBoxes[b] = rightBox;
+                    rightCounts[b] = rightCount;
+                }
+
+                AAlignedBBox leftBox;
+                size_t leftCount = 0;
+
+                for (int b = 0; b < binCount - 1; b++)
+                {
+                    leftBox = AAlignedBBox(leftBox, boxes[b]);
+                    leftCount += entries[b];
+
+                    if (leftCount == 0 || rightCounts[b + 1] == 0)
+                        continue;
+
+                    float cost = leftCount * leftBox.surfaceArea() + rightCounts[b + 1] * rightBoxes[b + 1].surfaceArea();
+
+                    if (cost < best.cost)
+                        best = { axis, range.min + (b + 1) * binWidth, cost };
+                }
+            }
+
+            return best;
+        }
+
+        /// @brief Distribute the references to the sides of a split plane, cutting those that cross it
+        ///        while the budget lasts.
+        static void splitReferences(const std::vector<Reference>& references, const SpatialSplit& split, SpatialSplitBudget& budget,
+                                    std::vector<Reference>& leftReferences, std::vector<Reference>& rightReferences)
+        {
+            for (const Reference& reference : references)
+            {
+                const Interval& extent = reference.bbox.axisInterval(split.axis);
+
+                if (reference.splittable && extent.min < split.position && extent.max > split.position && budget.remainingReferences > 0)
+                {
+                    budget.remainingReferences--;
+                    leftReferences.push_back(clippedReference(reference, split.axis, Interval(-infinity, split.position)));
+                    rightReferences.push_back(clippedReference(reference, split.axis, Interval(split.position, infinity)));
+                }
+                else if (reference.centroid[split.axis] < split.position)
+                    leftReferences.push_back(reference);
+                else
+                    rightReferences.push_back(reference);
+            }
+        }
+
+        void buildSpatial(std::vector<Reference>& references, SpatialSplitBudget& budget)
         {
-            bbox = AAlignedBBox::empty;
+            AAlignedBBox sweptBox;
+            AAlignedBBox boxAtStart;
+            AAlignedBBox boxAtEnd;
+
+            for (const Reference& reference : references)
+            {
+                sweptBox = AAlignedBBox(sweptBox, reference.bbox);
+                boxAtStart = AAlignedBBox(boxAtStart, reference.startBox);
+                boxAtEnd = AAlignedBBox(boxAtEnd, reference.endBox);
+            }
+
+            // The bounds come from the references, which are clipped where objects were cut, not
+            // from the objects below; that is where the tighter boxes come from.
+            setBounds(sweptBox, boxAtStart, boxAtEnd);
+
+            size_t count = references.size();
+
+            if (count == 1)
+            {
+                left = right = references[0].object;
+                return;
+            }
 
-            for (size_t objectID = start; objectID < end; objectID++)
-                bbox = AAlignedBBox(bbox, hittableObjects[objectID]->boundingBox());
+            if (count == 2)
+            {
+                left = references[0].object;
+                right = references[1].object;
+                return;
+            }
+
+            ObjectSplit objectSplit = findObjectSplit(references, 0, count, 1);
+            SpatialSplit spatialSplit;
+
+            if (budget.remainingReferences > 0 &&
+                (objectSplit.axis < 0 || overlapArea(objectSplit.leftBox, objectSplit.rightBox) > spatialSplitOverlap * budget.rootArea))
+                spatialSplit = findSpatialSplit(references, sweptBox);
+
+            std::vector<Reference> leftReferences;
+            std::vector<Reference> rightReferences;
+
+            if (spatialSplit.cost < objectSplit.cost)
+            {
+                splitReferences(references, spatialSplit, budget, leftReferences, rightReferences);
+
+                // A cut that leaves one side with everything would not make progress.
+                if (leftReferences.size() == count || rightReferences.size() == count)
+                {
+                    leftReferences.clear();
+                    rightReferences.clear();
+                }
+            }
+
+            if (leftReferences.empty() || rightReferences.empty())
+            {
+                auto rightSide = references.begin() + count / 2;
+
+                if (objectSplit.axis >= 0)
+                    rightSide = std::partition(references.begin(), references.end(), [&](const Reference& reference)
+                    {
+                        return objectSplit.goesLeft(reference);
+                    });
+
+                leftReferences.assign(references.begin(), rightSide);
+                rightReferences.assign(rightSide, references.end());
+            }
+
+            std::vector<Reference>().swap(references);
 
+            shared_ptr<BVHNode> leftNode(new BVHNode());
+            shared_ptr<BVHNode> rightNode(new BVHNode());
+
+            leftNode->buildSpatial(leftReferences, budget);
+            rightNode->buildSpatial(rightReferences, budget);
+
+            left = leftNode;
+            right = rightNode;
+        }
+
+        void buildMedian(std::vector<shared_ptr<Hittable>>& hittableObjects, size_t start, size_t end)
+        {
             int axis = randomInt(0, 2);
 
             auto comparator = (axis == 0) ? boxCompareX
@@ -74,11 +738,133 @@ class BVHNode : public Hittable
                 left = make_shared<BVHNode>(hittableObjects, start, middle);
                 right = make_shared<BVHNode>(hittableObjects, middle, end);
             }
+
+            updateBounds();
+        }
+
+        void buildSAH(std::vector<BuildObject>& objects, size_t start, size_t end, int threads)
+        {
+            size_t span = end - start;
+
+            if (span == 1)
+                left = right = objects[start].object;
+            else if (span == 2)
+            {
+                left = objects[start].object;
+                right = objects[start + 1].object;
+            }
+            else
+            {
+                size_t middle = splitSAH(objects, start, end, threads);
+
+                // The default constructor is private, which make_shared cannot call.
+                shared_ptr<BVHNode> leftNode(new BVHNode());
+                shared_ptr<BVHNode> rightNode(new BVHNode());
+
+                if (threads > 1 && span >= parallelSubtreeSize)
+                {
+                    int leftThreads = threads / 2;
+                    std::thread leftBuilder([&] { leftNode->buildSAH(objects, start, middle, leftThreads); });
+
+                    rightNode->buildSAH(objects, middle, end, threads - leftThreads);
+                    leftBuilder.join();
+                }
+                else
+                {
+                    leftNode->buildSAH(objects, start, middle, 1);
+                    rightNode->buildSAH(objects, middle, end, 1);
+                }
+
+                left = leftNode;
+                right = rightNode;
+            }
+
+            updateBounds();
+        }
+
+    
+    public:
+        // Directory for cached trees (see FlatNode); empty disables the cache.
+        static inline std::string cacheDirectory;
+        // Method for trees built without naming one.
+        static inline BVHBuildMethod defaultBuildMethod = BVHBuildMethod::BinnedSAH;
+        // References the spatial split builder may add by cutting objects, as a fraction of the object count.
+        static inline float spatialSplitGrowth = 0.5f;
+
+        /// @brief The file in cacheDirectory a binned SAH tree over these objects is cached in.
+        static std::string cacheFilename(const std::vector<shared_ptr<Hittable>>& hittableObjects)
+        {
+            return cacheFilename(hashInputs(hittableObjects));
+        }
+
+        BVHNode(HittableList list, BVHBuildMethod method = defaultBuildMethod) : BVHNode(list.hittableObjects, method) {}
+
+        /// @param threads Threads the SAH builder may use; the median builder always uses one.
+        /// @param useCache Whether the SAH builder may use the cache directory. Trees over objects that
+        ///        change every frame would only fill it with files that are never read again.
+        BVHNode(std::vector<shared_ptr<Hittable>> hittableObjects, BVHBuildMethod method,
+                int threads = std::max(1u, std::thread::hardware_concurrency()), bool useCache = true)
+        {
+            if (method == BVHBuildMethod::Median)
+            {
+                buildMedian(hittableObjects, 0, hittableObjects.size());
+                return;
+            }
+
+            if (method == BVHBuildMethod::SpatialSplits)
+            {
+                std::vector<Reference> references;
+                AAlignedBBox rootBox;
+
+                for (const shared_ptr<Hittable>& hittableObject : hittableObjects)
+                {
+                    AAlignedBBox objectBox = hittableObject->boundingBox();
+
+                    references.push_back({ objectBox, hittableObject->boundingBoxAt(0.0f), hittableObject->boundingBoxAt(1.0f),
+                                           centerOf(hittableObject->boundingBoxAt(0.5f)), hittableObject,
+                                           hittableObject->supportsSpatialSplits() });
+                    rootBox = AAlignedBBox(rootBox, objectBox);
+                }
+
+                SpatialSplitBudget budget = { size_t(spatialSplitGrowth * hittableObjects.size()), rootBox.surfaceArea() };
+                buildSpatial(references, budget);
+
+                return;
+            }
+
+            bool cached = useCache && !cacheDirectory.empty() && hittableObjects.size() >= cacheMinimumObjects;
+            uint64_t inputHash = cached ? hashInputs(hittableObjects) : 0;
+
+            if (cached && readCache(hittableObjects, inputHash))
+                return;
+
+            std::vector<BuildObject> objects(hittableObjects.size());
+
+            forChunks(0, objects.size(), (objects.size() >= parallelBinningSize) ? threads : 1, [&](size_t chunkStart, size_t chunkEnd, int /*chunk*/)
+            {
+                for (size_t i = chunkStart; i < chunkEnd; i++)
+                {
+                    // Centroids at mid-exposure, as in boxCompare().
+                    objects[i].bbox = hittableObjects[i]->boundingBox();
+                    objects[i].centroid = centerOf(hittableObjects[i]->boundingBoxAt(0.5f));
+                    objects[i].object = hittableObjects[i];
+                }
+            });
+
+            buildSAH(objects, 0, objects.size(), threads);
+
+            if (cached)
+                writeCache(hittableObjects, inputHash);
+        }
+
+        BVHNode(std::vector<shared_ptr<Hittable>>& hittableObjects, size_t start, size_t end)
+        {
+            buildMedian(hittableObjects, start, end);
         }
 
         bool hit(const Ray& ray, Interval rayT, HitRecord& record) const override
         {
-            if (!bbox.hit(ray, rayT)) return false;
+            if (!boxAt(ray.time()).hit(ray, rayT)) return false;
 
             bool hitLeft = left->hit(ray, rayT, record);
             bool hitRight = right->hit(ray, Interval(rayT.min, hitLeft ? record.t : rayT.max), record);
@@ -86,7 +872,127 @@ class BVHNode : public Hittable
             return hitLeft || hitRight;
         }
 
+        /// @brief Any-hit traversal: stops at the first child that reports a hit. A leaf holding a
+        ///        single object has it as both children; it is tested once.
+        bool occluded(const Ray& ray, Interval rayT) const override
+        {
+            if (!boxAt(ray.time()).hit(ray, rayT)) return false;
+
+            return left->occluded(ray, rayT) || (right != left && right->occluded(ray, rayT));
+        }
+
+        /// @brief Trace a packet through the tree: nodes are culled for the whole packet first, then
+        ///        tested per ray, and only rays that hit the node's box descend. The rays of a packet
+        ///        have different times, so moving nodes are tested with their whole swept box.
+        void hitPacket(RayPacket& packet, const bool* active, float tMin, float* closest, HitRecord* records, bool* hits) const override
+        {
+            float farthest = tMin;
+
+            for (int i = 0; i < packet.size; i++)
+                farthest = active[i] ? std::max(farthest, closest[i]) : farthest;
+
+            if (packet.missesAll(bbox, tMin, farthest)) return;
+
+            bool hitsBox[maxPacketSize];
+
+            if (!packet.hitBox(bbox, active, tMin, closest, hitsBox)) return;
+
+            left->hitPacket(packet, hitsBox, tMin, closest, records, hits);
+            right->hitPacket(packet, hitsBox, tMin, closest, records, hits);
+        }
+
         AAlignedBBox boundingBox() const override { return bbox; }
+
+        AAlignedBBox boundingBoxAt(float time) const override { return boxAt(time); }
+
+        /// @brief Refit the tree to objects that moved, bottom-up in time linear in its size. The tree
+        ///        keeps its structure, so its quality degrades as objects move far; see sahCost().
+        ///        Nodes of a spatial split tree are refitted to whole objects, losing their clipped bounds.
+        void refit() override
+        {
+            left->refit();
+
+            if (right != left)
+                right->refit();
+
+            updateBounds();
+        }
+
+        /// @brief Expected number of box and object tests for a ray that hits this node's box, by the
+        ///        surface area heuristic: a child is visited with probability area(child) / area(node).
+        float sahCost() const
+        {
+            float area = bbox.surfaceArea();
+            float cost = 1.0f + subtreeCost(*left) * left->boundingBox().surfaceArea() / area;
+
+            if (right != left)
+                cost += subtreeCost(*right) * right->boundingBox().surfaceArea() / area;
+
+            return cost;
+        }
+};
+
+
+// BVH over objects that move from frame to frame, e.g. the Translate and RotateY instances of a
+// turntable or fly-through. update() refits the tree instead of rebuilding it, and rebuilds only
+// once refitting has made it noticeably worse than a fresh build. Keep static objects in a separate
+// tree: a large one like a ground sphere dominates the SAH cost and hides how the rest degrades.
+class DynamicBVH : public Hittable
+{
+    private:
+        std::vector<shared_ptr<Hittable>> hittableObjects;
+        shared_ptr<BVHNode> root;
+        float builtCost;
+
+
+    public:
+        // Rebuild once the refitted tree's SAH cost exceeds the cost after the last build by this factor.
+        float rebuildThreshold = 1.25f;
+
+        DynamicBVH(HittableList list) : hittableObjects(list.hittableObjects) { rebuild(); }
+
+        void rebuild()
+        {
+            for (const shared_ptr<Hittable>& hittableObject : hittableObjects)
+                hittableObject->refit();
+
+            // The objects have moved since any earlier build, so a cached tree would never be reused.
+            root = make_shared<BVHNode>(hittableObjects, BVHBuildMethod::BinnedSAH,
+                                        std::max(1u, std::thread::hardware_concurrency()), false);
+            builtCost = root->sahCost();
+        }
+
+        /// @brief Bring the tree up to date after objects moved.
+        /// @return Whether the tree was rebuilt instead of only refitted.
+        bool update()
+        {
+            root->refit();
+
+            if (root->sahCost() <= rebuildThreshold * builtCost)
+                return false;
+
+            rebuild();
+
+            return true;
+        }
+
+        /// @brief SAH cost of the current tree relative to right after its last build.
+        float costRatio() const { return root->sahCost() / builtCost; }
+
+        bool hit(const Ray& ray, Interval rayT, HitRecord& record) const override { return root->hit(ray, rayT, record); }
+
+        bool occluded(const Ray& ray, Interval rayT) const override { return root->occluded(ray, rayT); }
+
+        void hitPacket(RayPacket& packet, const bool* active, float tMin, float* closest, HitRecord* records, bool* hits) const override
+        {
+            root->hitPacket(packet, active, tMin, closest, records, hits);
+        }
+
+        AAlignedBBox boundingBox() const override { return root->boundingBox(); }
+
+        AAlignedBBox boundingBoxAt(float time) const override { return root->boundingBoxAt(time); }
+
+        void refit() override { update(); }
 };
 
 #endif
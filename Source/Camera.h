@@ -1,14 +1,38 @@
 #ifndef CAMERA_H
 #define CAMERA_H
 
+#include "Checkpoint.h"
 #include "Hittable.h"
 #include "Material.h"
+#include "ProgressReporter.h"
+#include "Sampler.h"
+#include "Wavefront.h"
 
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
 #include <iomanip>
+#include <map>
 #include <mutex>
+#include <numeric>
+#include <string>
 #include <thread>
+#include <vector>
+
+
+// Rectangle of pixels [x0, x1) x [y0, y1).
+struct PixelRect
+{
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+
+    int width() const { return x1 - x0; }
+    int height() const { return y1 - y0; }
+};
 
 
 class Camera
@@ -26,6 +50,17 @@ class Camera
         Vector3 defocusDiskHorizontal;
         Vector3 defocusDiskVertical;
 
+        // Crop window in pixels, [cropX0, cropX1) x [cropY0, cropY1)
+        int     cropX0;
+        int     cropY0;
+        int     cropX1;
+        int     cropY1;
+        int     cropWidth;
+        int     cropHeight;
+        int     pixelCropWindow[4]  = { 0, 0, -1, -1 };
+        float   normalizedCropWindow[4] = { 0.0f, 0.0f, 1.0f, 1.0f };
+        bool    hasPixelCropWindow  = false;
+
 
         void init()
         {
@@ -60,53 +95,374 @@ class Camera
             float defocusRadius = focusDistance * std::tan(deg2rad(defocusAngle / 2));
             defocusDiskHorizontal = u * defocusRadius;
             defocusDiskVertical = v * defocusRadius;
+
+            // Crop window
+            if (hasPixelCropWindow)
+            {
+                cropX0 = pixelCropWindow[0];
+                cropY0 = pixelCropWindow[1];
+                cropX1 = pixelCropWindow[2];
+                cropY1 = pixelCropWindow[3];
+            }
+            else
+            {
+                cropX0 = int(std::floor(normalizedCropWindow[0] * imageWidth));
+                cropY0 = int(std::floor(normalizedCropWindow[1] * imageHeight));
+                cropX1 = int(std::ceil(normalizedCropWindow[2] * imageWidth));
+                cropY1 = int(std::ceil(normalizedCropWindow[3] * imageHeight));
+            }
+
+            cropX0 = std::clamp(cropX0, 0, imageWidth - 1);
+            cropY0 = std::clamp(cropY0, 0, imageHeight - 1);
+            cropX1 = std::clamp(cropX1, cropX0 + 1, imageWidth);
+            cropY1 = std::clamp(cropY1, cropY0 + 1, imageHeight);
+            cropWidth = cropX1 - cropX0;
+            cropHeight = cropY1 - cropY0;
         }
 
+        bool insideCropWindow(int x, int y) const
+        {
+            return cropX0 <= x && x < cropX1 && cropY0 <= y && y < cropY1;
+        }
 
-        Ray getRay(int x, int y) const
+        /// @brief Write the PPM header for either the crop window or the full frame.
+        void writeImageHeader(std::ostream& out) const
         {
-            Vector3 offset = sampleSquare();
+            int outputWidth = writeFullFrame ? imageWidth : cropWidth;
+            int outputHeight = writeFullFrame ? imageHeight : cropHeight;
+
+            out << "P3\n" << outputWidth << " " << outputHeight << "\n255\n";
+        }
+
+        /// @brief Write an image of the crop window, or of the full frame with the crop in its place
+        ///        and black everywhere else.
+        /// @param cropPixel Returns the final color of a pixel, given its index inside the crop window.
+        template <typename PixelFunction>
+        void writeImage(std::ostream& out, PixelFunction cropPixel) const
+        {
+            writeImageHeader(out);
+
+            int outputX0 = writeFullFrame ? 0 : cropX0;
+            int outputY0 = writeFullFrame ? 0 : cropY0;
+            int outputX1 = writeFullFrame ? imageWidth : cropX1;
+            int outputY1 = writeFullFrame ? imageHeight : cropY1;
+
+            for (int y = outputY0; y < outputY1; y++)
+                for (int x = outputX0; x < outputX1; x++)
+                    writeColor(out, insideCropWindow(x, y) ? cropPixel((y - cropY0) * cropWidth + (x - cropX0)) : Color(0));
+        }
+
+
+        Ray getRay(int x, int y, Sampler& sampler) const
+        {
+            Vector3 offset = sampleSquare(sampler);
             Vector3 pixelSample =   centerPixelPosition +
                                     ((x + offset.x()) * pixelDeltaX) +
                                     ((y + offset.y()) * pixelDeltaY);
             
-            Point3 rayOrigin = (defocusAngle <= 0) ? center : defocusDiskSample();
+            Point3 rayOrigin = (defocusAngle <= 0) ? center : defocusDiskSample(sampler);
             Vector3 rayDirection = pixelSample - rayOrigin;
-            float rayTime = randomFloat();
+            float rayTime = sampler.get1D();
 
             return Ray(rayOrigin, rayDirection, rayTime);
         }
 
-        Vector3 sampleSquare() const { return Vector3(randomFloat() - 0.5f, randomFloat() - 0.5f, 0); }
+        Vector3 sampleSquare(Sampler& sampler) const { return sampler.get2D() - Vector3(0.5f, 0.5f, 0); }
 
-        Point3 defocusDiskSample() const
+        Point3 defocusDiskSample(Sampler& sampler) const
         {
-            Vector3 p = randomInUnitDisk();
+            Vector3 p = sampleUniformDisk(sampler.get2D());
             return center + (p.x() * defocusDiskHorizontal) + (p.y() * defocusDiskVertical);
         }
 
-        Color rayColor(const Ray& ray, int depth, const Hittable& world) const
+        Color rayColor(const Ray& ray, int depth, const Hittable& world, Sampler& sampler) const
         {
             if (depth <= 0)
                 return Color(0.0f);
 
             HitRecord record;
+            threadRayCount++;
 
             if (!world.hit(ray, Interval(0.0001f, infinity), record))
                 return backgroundColor;
 
+            return shadeHit(ray, record, depth, world, sampler);
+        }
+
+        /// @brief Color of a ray that hit the world, as described by record.
+        Color shadeHit(const Ray& ray, const HitRecord& record, int depth, const Hittable& world, Sampler& sampler) const
+        {
             // Objects of the world
             Ray scattered;
             Color attenuation;
             Color emissionColor = record.mat->emitted(record.u, record.v, record.p);
 
-            if (!record.mat->scatter(ray, record, attenuation, scattered))
+            if (!record.mat->scatter(ray, record, attenuation, scattered, sampler))
                 return emissionColor;
             
-            Color scatterColor = attenuation * rayColor(scattered, depth - 1, world);
+            Color scatterColor = attenuation * rayColor(scattered, depth - 1, world, sampler);
 
             return emissionColor + scatterColor;
         }
+
+        /// @brief Trace samples [firstSample, firstSample + sampleCount) of a pixel.
+        /// @param luminanceSquaredSum If given, the squared luminance of every sample is added to it.
+        /// @return The sum of the sample colors.
+        Color samplePixel
+        (
+            int x,
+            int y,
+            int firstSample,
+            int sampleCount,
+            const Hittable& world,
+            Sampler& sampler,
+            float* luminanceSquaredSum = nullptr
+        ) const
+        {
+            Color pixelColor = Color(0.0f);
+            uint64_t pixelIndex = uint64_t(y) * imageWidth + x;
+
+            for (int i = firstSample; i < firstSample + sampleCount; i++)
+            {
+                // Every pixel sample has its own random stream, derived from (seed, pixel, sample), so
+                // the image does not depend on thread count, tile order or how the frame is split up.
+                seedRandom(hashCombine(hashCombine(seed, pixelIndex), uint64_t(i)));
+                sampler.startPixelSample(x, y, i);
+
+                Ray ray = getRay(x, y, sampler);
+                Color sampleColor = rayColor(ray, maxDepth, world, sampler);
+
+                pixelColor += sampleColor;
+
+                if (luminanceSquaredSum != nullptr)
+                    *luminanceSquaredSum += luminance(sampleColor) * luminance(sampleColor);
+            }
+
+            return pixelColor;
+        }
+
+        /// @brief Trace samples [firstSample, firstSample + sampleCount) of every pixel in a rectangle. With
+        ///        packetTracing, the primary rays of up to 8 x 8 pixels are traced through the world as one
+        ///        packet and only the bounces are traced one by one; the result is the same either way.
+        /// @param pixelSums Receives the sum of the sample colors of each pixel, row by row.
+        void sampleRect(const PixelRect& rect, int firstSample, int sampleCount, const Hittable& world, Sampler& sampler, Color* pixelSums) const
+        {
+            if (wavefront)
+            {
+                sampleRectWavefront(rect, firstSample, sampleCount, world, sampler, pixelSums);
+                return;
+            }
+
+            if (!packetTracing)
+            {
+                for (int y = rect.y0; y < rect.y1; y++)
+                    for (int x = rect.x0; x < rect.x1; x++)
+                        pixelSums[(y - rect.y0) * rect.width() + (x - rect.x0)] = samplePixel(x, y, firstSample, sampleCount, world, sampler);
+
+                return;
+            }
+
+            const int packetSide = 8;
+
+            RayPacket packet;
+            HitRecord records[maxPacketSize];
+            bool active[maxPacketSize];
+            bool hits[maxPacketSize];
+            float closest[maxPacketSize];
+
+            for (int packetY = rect.y0; packetY < rect.y1; packetY += packetSide)
+                for (int packetX = rect.x0; packetX < rect.x1; packetX += packetSide)
+                {
+                    int x1 = std::min(packetX + packetSide, rect.x1);
+                    int y1 = std::min(packetY + packetSide, rect.y1);
+
+                    for (int y = packetY; y < y1; y++)
+                        for (int x = packetX; x < x1; x++)
+                            pixelSums[(y - rect.y0) * rect.width() + (x - rect.x0)] = Color(0.0f);
+
+                    for (int i = firstSample; i < firstSample + sampleCount; i++)
+                    {
+                        packet.clear();
+
+                        for (int y = packetY; y < y1; y++)
+                            for (int x = packetX; x < x1; x++)
+                            {
+                                seedRandom(hashCombine(hashCombine(seed, uint64_t(y) * imageWidth + x), uint64_t(i)));
+                                sampler.startPixelSample(x, y, i);
+                                packet.add(getRay(x, y, sampler), threadRandomGenerator);
+                            }
+
+                        packet.finalize();
+
+                        for (int k = 0; k < packet.size; k++)
+                        {
+                            active[k] = true;
+                            hits[k] = false;
+                            closest[k] = infinity;
+                        }
+
+                        if (maxDepth > 0)
+                            world.hitPacket(packet, active, 0.0001f, closest, records, hits);
+
+                        // Shade each ray with the random stream and sampler state it would have on its own.
+                        for (int k = 0; k < packet.size; k++)
+                        {
+                            int x = packetX + k % (x1 - packetX);
+                            int y = packetY + k / (x1 - packetX);
+
+                            threadRandomGenerator = packet.generators[k];
+                            sampler.startPixelSample(x, y, i);
+                            getRay(x, y, sampler);
+
+                            Color sampleColor = Color(0.0f);
+
+                            if (maxDepth > 0)
+                            {
+                                threadRayCount++;
+                                sampleColor = hits[k] ? shadeHit(packet.rays[k], records[k], maxDepth, world, sampler) : backgroundColor;
+                            }
+
+                            pixelSums[(y - rect.y0) * rect.width() + (x - rect.x0)] += sampleColor;
+                        }
+                    }
+                }
+        }
+
+        /// @brief sampleRect() with the wavefront integrator: the samples are traced in batches of up to
+        ///        wavefrontBatchSize paths, one bounce of the whole batch at a time.
+        void sampleRectWavefront(const PixelRect& rect, int firstSample, int sampleCount, const Hittable& world, Sampler& sampler, Color* pixelSums) const
+        {
+            WavefrontIntegrator integrator;
+            std::vector<int> pathPixels;
+
+            auto traceBatch = [&]()
+            {
+                integrator.trace(world, maxDepth, backgroundColor, sampler);
+
+                const std::vector<Color>& pathColors = integrator.pathRadiance();
+
+                for (size_t i = 0; i < pathColors.size(); i++)
+                    pixelSums[pathPixels[i]] += pathColors[i];
+
+                integrator.clear();
+                pathPixels.clear();
+            };
+
+            for (int y = rect.y0; y < rect.y1; y++)
+                for (int x = rect.x0; x < rect.x1; x++)
+                {
+                    int pixel = (y - rect.y0) * rect.width() + (x - rect.x0);
+                    pixelSums[pixel] = Color(0.0f);
+
+                    for (int i = firstSample; i < firstSample + sampleCount; i++)
+                    {
+                        seedRandom(hashCombine(hashCombine(seed, uint64_t(y) * imageWidth + x), uint64_t(i)));
+                        sampler.startPixelSample(x, y, i);
+
+                        Ray ray = getRay(x, y, sampler);
+
+                        integrator.addPath(ray, x, y, i, sampler.currentDimension(), threadRandomGenerator);
+                        pathPixels.push_back(pixel);
+
+                        if (integrator.pathCount() >= size_t(std::max(1, wavefrontBatchSize)))
+                            traceBatch();
+                    }
+                }
+
+            traceBatch();
+        }
+
+        /// @brief Write accumulated pixel sums, each normalized by its own sample count.
+        void writeImage(std::ostream& out, const std::vector<Color>& accumulatedColor, const std::vector<uint32_t>& sampleCounts) const
+        {
+            writeImage(out, [&](int i) { return accumulatedColor[i] / float(std::max(1u, sampleCounts[i])); });
+        }
+
+        /// @brief Write the image to a temporary file first, so viewers never see a half-written snapshot.
+        void writeSnapshot(const std::vector<Color>& accumulatedColor, const std::vector<uint32_t>& sampleCounts) const
+        {
+            std::string temporaryFilename = snapshotFilename + ".tmp";
+
+            {
+                std::ofstream snapshot(temporaryFilename);
+                writeImage(snapshot, accumulatedColor, sampleCounts);
+            }
+
+            std::error_code error;
+            std::filesystem::rename(temporaryFilename, snapshotFilename, error);
+
+            if (error)
+                std::cerr << "\nError: could not write snapshot '" << snapshotFilename << "': " << error.message() << "\n";
+        }
+
+        /// @brief Hash of the camera and the world's bounds, so a checkpoint is not resumed after either changed.
+        uint64_t sceneHash(const Hittable& world) const
+        {
+            uint64_t hash = 0;
+
+            auto hashFloat = [&hash](float value)
+            {
+                uint32_t bits;
+                std::memcpy(&bits, &value, sizeof(float));
+
+                hash = hashCombine(hash, bits);
+            };
+
+            for (float value : { aspectRatio, verticalFOV, defocusAngle, focusDistance })
+                hashFloat(value);
+
+            for (const Vector3& vector : { lookfrom, lookat, vup, backgroundColor })
+                for (int i = 0; i < 3; i++)
+                    hashFloat(vector[i]);
+
+            AAlignedBBox worldBox = world.boundingBox();
+
+            for (int axis = 0; axis < 3; axis++)
+            {
+                hashFloat(worldBox.axisInterval(axis).min);
+                hashFloat(worldBox.axisInterval(axis).max);
+            }
+
+            return hash;
+        }
+
+        /// @brief Report the sample counts reached and the estimated remaining noise, as the
+        ///        standard error of each pixel's mean luminance relative to that mean.
+        void logSampleStatistics(const RenderCheckpoint& state) const
+        {
+            double sampleSum = 0.0;
+            double relativeErrorSum = 0.0;
+            int relativeErrorCount = 0;
+            uint32_t minSamples = std::numeric_limits<uint32_t>::max();
+            uint32_t maxSamples = 0;
+
+            for (size_t i = 0; i < state.sampleCounts.size(); i++)
+            {
+                uint32_t n = state.sampleCounts[i];
+
+                sampleSum += n;
+                minSamples = std::min(minSamples, n);
+                maxSamples = std::max(maxSamples, n);
+
+                if (n < 2) continue;
+
+                double mean = luminance(state.accumulatedColor[i]) / n;
+                double variance = (state.luminanceSquaredSum[i] / n - mean * mean) * n / (n - 1);
+                double standardError = std::sqrt(std::max(0.0, variance) / n);
+
+                if (mean > 1e-3)
+                {
+                    relativeErrorSum += standardError / mean;
+                    relativeErrorCount++;
+                }
+            }
+
+            std::clog << "\nSamples per pixel: " << std::fixed << std::setprecision(1)
+                      << sampleSum / std::max<size_t>(1, state.sampleCounts.size())
+                      << " average (" << minSamples << " - " << maxSamples << "). Estimated noise: "
+                      << std::setprecision(2) << 100.0 * relativeErrorSum / std::max(1, relativeErrorCount)
+                      << "% relative standard error.\n";
+        }
     
     
     public:
@@ -121,139 +477,374 @@ class Camera
         Point3  lookat          = Point3(0, 0, -1);
         Vector3 vup             = Vector3(0, 1, 0);
         Color   backgroundColor;
+        SamplerType samplerType = SamplerType::Sobol;
+        uint64_t seed           = 0;     // Renders with the same seed and settings are bitwise identical
+        std::string sceneName   = "";    // Stored in checkpoints, so they are only resumed for the same scene
+
+        // Progressive rendering
+        int     samplesPerPass          = 8;
+        float   snapshotInterval        = 0.0f;  // Seconds between snapshots; 0 writes one after every pass
+        std::string snapshotFilename    = "snapshot.ppm";
+        std::string checkpointFilename  = "";    // Empty disables checkpoints
+        float   checkpointInterval      = 60.0f; // Seconds between checkpoints
+        bool    resumeFromCheckpoint    = false;
+        float   timeBudget              = 0.0f;  // Seconds; if > 0, stop adding samples at the deadline
+
+        // Output the full frame with the crop window in place instead of only the crop window.
+        bool    writeFullFrame          = false;
+
+        bool    quiet                   = false; // No progress or timing output
+        bool    packetTracing           = false; // Trace primary rays in packets of 8 x 8 pixels
+        bool    wavefront               = false; // Trace paths breadth-first with the wavefront integrator
+        int     wavefrontBatchSize      = 1 << 16; // Paths in flight per thread with the wavefront integrator
+
+        // Streaming output of multithreadedRender
+        int     rowsPerBand             = 8;
+        int     maxBandsInFlight        = 0;     // Bands rendered or waiting for output at once; 0 picks 2 per thread
+
+        /// @brief Only trace the pixels in [x0, x1) x [y0, y1). The camera projection stays that of the full image.
+        void setCropWindowPixels(int x0, int y0, int x1, int y1)
+        {
+            pixelCropWindow[0] = x0;
+            pixelCropWindow[1] = y0;
+            pixelCropWindow[2] = x1;
+            pixelCropWindow[3] = y1;
+            hasPixelCropWindow = true;
+        }
+
+        /// @brief Only trace the pixels in a window given in [0, 1] image coordinates (y pointing down).
+        void setCropWindowNormalized(float minX, float minY, float maxX, float maxY)
+        {
+            normalizedCropWindow[0] = minX;
+            normalizedCropWindow[1] = minY;
+            normalizedCropWindow[2] = maxX;
+            normalizedCropWindow[3] = maxY;
+            hasPixelCropWindow = false;
+        }
 
         void render(const Hittable& world)
         {
             init();
 
-            auto renderStartTime = std::chrono::high_resolution_clock::now();
+            writeImageHeader(std::cout);
+
+            std::unique_ptr<Sampler> sampler = makeSampler(samplerType, samplesPerPixel, seed);
 
-            std::cout << "P3\n" << imageWidth << " " << imageHeight << "\n255\n";
+            int outputX0 = writeFullFrame ? 0 : cropX0;
+            int outputY0 = writeFullFrame ? 0 : cropY0;
+            int outputX1 = writeFullFrame ? imageWidth : cropX1;
+            int outputY1 = writeFullFrame ? imageHeight : cropY1;
 
+            ProgressReporter progress(outputY1 - outputY0, "rows", !quiet);
+
+            // Packets span 8 rows and wavefront batches gain from many paths, so both trace 8 rows at a time.
+            int bandHeight = (packetTracing || wavefront) ? 8 : 1;
+            std::vector<Color> pixels;
     
-            for (int y = 0; y < imageHeight; y++)
+            for (int bandY = outputY0; bandY < outputY1; bandY += bandHeight)
             {
-                auto renderCurrentTime = std::chrono::high_resolution_clock::now();
-                std::chrono::duration<float> renderElapsedTime = renderCurrentTime - renderStartTime;
-                int renderMinutes = static_cast<int>(renderElapsedTime.count()) / 60;
-                int renderSeconds = static_cast<int>(renderElapsedTime.count()) % 60;
-
-                std::clog << "\rProcessing... (row " << y+1 << " of " << imageHeight << ") "
-                          << std::setw(2) << std::setfill('0') << renderMinutes << ":"
-                          << std::setw(2) << std::setfill('0') << renderSeconds << " elapsed." << std::flush; 
-            
-                for (int x = 0; x < imageWidth; x++)
+                int bandY1 = std::min(bandY + bandHeight, outputY1);
+                PixelRect traced = { cropX0, std::max(bandY, cropY0), cropX1, std::min(bandY1, cropY1) };
+
+                if (traced.height() > 0)
                 {
-                    Color pixelColor = Color(0.0f);
+                    pixels.resize(size_t(traced.width()) * traced.height());
+                    sampleRect(traced, 0, samplesPerPixel, world, *sampler, pixels.data());
+                }
 
-                    for (int i = 0; i < samplesPerPixel; i++)
+                for (int y = bandY; y < bandY1; y++)
+                {
+                    for (int x = outputX0; x < outputX1; x++)
                     {
-                        Ray ray = getRay(x, y);
-                        pixelColor += rayColor(ray, maxDepth, world);
+                        if (!insideCropWindow(x, y))
+                        {
+                            writeColor(std::cout, Color(0));
+                            continue;
+                        }
+
+                        Color pixelColor = pixels[(y - traced.y0) * traced.width() + (x - traced.x0)];
+
+                        writeColor(std::cout, pixelSampleScale * pixelColor);
                     }
 
-                    writeColor(std::cout, pixelSampleScale * pixelColor);
+                    progress.add(1);
                 }
             }
 
-            auto renderEndTime = std::chrono::high_resolution_clock::now();
-            std::chrono::duration<float> renderTotalTime = renderEndTime - renderStartTime;
-            int renderTotalMinutes = static_cast<int>(renderTotalTime.count()) / 60;
-            int renderTotalSeconds = static_cast<int>(renderTotalTime.count()) % 60;
-
-        
-            std::clog << "\rDone. Render time: "
-            << std::setw(2) << std::setfill('0') << renderTotalMinutes << ":"
-            << std::setw(2) << std::setfill('0') << renderTotalSeconds << ".                   ";
+            progress.stop();
         }
 
+        /// @brief Render on all cores in bands of rowsPerBand rows. Finished bands are written to stdout in
+        ///        image order and freed right away; a band is only started when it is fewer than
+        ///        maxBandsInFlight bands ahead of the output, so memory use does not grow with the image.
         void multithreadedRender(const Hittable& world)
         {
             init();
 
-            auto renderStartTime = std::chrono::high_resolution_clock::now();
-            std::cout << "P3\n" << imageWidth << " " << imageHeight << "\n255\n";
-
-            // Pixel buffer
-            std::vector<Color> pixelBuffer = std::vector<Color>(imageWidth * imageHeight);
-
-            // Multithreading computation
-            std::atomic<int> completedRows = 0; 
             const int NUMTHREADS = 2 * std::thread::hardware_concurrency();
+            const int bandHeight = std::max(1, rowsPerBand);
+            const int bandCount = (cropHeight + bandHeight - 1) / bandHeight;
+            const int bandsInFlight = std::max(1, maxBandsInFlight > 0 ? maxBandsInFlight : 2 * NUMTHREADS);
+
+            // Reorder buffer of finished bands that can not be written yet
+            std::map<int, std::vector<Color>> finishedBands;
+            int nextBandToWrite = 0;
+            std::atomic<int> nextBand = 0;
             std::vector<std::thread> threads;
-            std::mutex logMutex;
+            std::mutex outputMutex;
+            std::condition_variable bandWritten;
 
+            int outputX0 = writeFullFrame ? 0 : cropX0;
+            int outputX1 = writeFullFrame ? imageWidth : cropX1;
 
-            auto renderChunk = [&](int startY, int endY)
+            auto writeBlackRow = [&]()
             {
-                for (int y = startY; y < endY; y++)
+                for (int x = outputX0; x < outputX1; x++)
+                    writeColor(std::cout, Color(0));
+            };
+
+            ProgressReporter progress(cropHeight, "rows", !quiet);
+
+            writeImageHeader(std::cout);
+
+            if (writeFullFrame)
+                for (int y = 0; y < cropY0; y++) writeBlackRow();
+
+            // Write all bands that are next in line; called with outputMutex held.
+            auto flushBands = [&]()
+            {
+                for (auto band = finishedBands.find(nextBandToWrite); band != finishedBands.end(); band = finishedBands.find(nextBandToWrite))
+                {
+                    const std::vector<Color>& pixels = band->second;
+                    int rows = int(pixels.size()) / cropWidth;
+
+                    for (int row = 0; row < rows; row++)
+                        for (int x = outputX0; x < outputX1; x++)
+                            writeColor(std::cout, (cropX0 <= x && x < cropX1) ? pixels[row * cropWidth + (x - cropX0)] : Color(0));
+
+                    finishedBands.erase(band);
+                    nextBandToWrite++;
+                }
+
+                bandWritten.notify_all();
+            };
+
+            auto renderBands = [&]()
+            {
+                std::unique_ptr<Sampler> sampler = makeSampler(samplerType, samplesPerPixel, seed);
+
+                for (int band = nextBand++; band < bandCount; band = nextBand++)
                 {
-                    // Logging
+                    // Wait until the output has caught up, so at most bandsInFlight bands are held.
                     {
-                        completedRows++;  // Atomically increment completed row count
-
-                        std::lock_guard<std::mutex> lock(logMutex);
-                        auto currentTime = std::chrono::high_resolution_clock::now();
-                        std::chrono::duration<float> elapsedTime = currentTime - renderStartTime;
-                        int minutes = static_cast<int>(elapsedTime.count()) / 60;
-                        int seconds = static_cast<int>(elapsedTime.count()) % 60;
-
-                        float progress = (static_cast<float>(completedRows) / imageHeight) * 100.0f;
-
-                        std::clog << "\rProcessing... " 
-                                  << std::fixed << std::setprecision(2) << progress << "% "
-                                  << "(" << completedRows << " / " << imageHeight << " rows) "
-                                  << std::setw(2) << std::setfill('0') << minutes << ":"
-                                  << std::setw(2) << std::setfill('0') << seconds << " elapsed. ("
-                                  << threads.size() << " threads running)       "
-                                  << std::flush;
+                        std::unique_lock<std::mutex> lock(outputMutex);
+                        bandWritten.wait(lock, [&]() { return band < nextBandToWrite + bandsInFlight; });
                     }
-                    
-                    for (int x = 0; x < imageWidth; x++)
-                    {
-                        Color pixelColor = Color(0);
 
-                        for (int i = 0; i < samplesPerPixel; i++)
-                        {
-                            Ray ray = getRay(x, y);
-                            pixelColor += rayColor(ray, maxDepth, world);
-                        }
+                    int startY = cropY0 + band * bandHeight;
+                    int endY = std::min(startY + bandHeight, cropY1);
+                    std::vector<Color> pixels(size_t(endY - startY) * cropWidth);
 
-                        pixelBuffer[y * imageWidth + x] = pixelSampleScale * pixelColor;
-                    }
+                    sampleRect({ cropX0, startY, cropX1, endY }, 0, samplesPerPixel, world, *sampler, pixels.data());
+
+                    for (Color& pixel : pixels)
+                        pixel = pixelSampleScale * pixel;
+
+                    progress.add(endY - startY);
+
+                    std::lock_guard<std::mutex> lock(outputMutex);
+
+                    finishedBands[band] = std::move(pixels);
+                    flushBands();
                 }
             };
 
             // Create threads
-            int rowsPerThread = imageHeight / NUMTHREADS;
-
             for (int i = 0; i < NUMTHREADS; i++)
+                threads.emplace_back(renderBands);
+
+            // Wait for threads
+            for (auto& thread : threads) thread.join();
+
+            if (writeFullFrame)
+                for (int y = cropY1; y < imageHeight; y++) writeBlackRow();
+
+            std::cout << std::flush;
+
+            progress.stop();
+        }
+
+        /// @brief Render the whole frame in passes of samplesPerPass samples per pixel, accumulating into
+        ///        a float buffer. After a pass (or once snapshotInterval seconds have passed) the current
+        ///        estimate is written to snapshotFilename, so the render can be stopped when good enough.
+        ///        With a checkpointFilename the accumulation state is saved every checkpointInterval seconds;
+        ///        resumeFromCheckpoint continues from it with the same result as an uninterrupted render.
+        ///        With a timeBudget, passes are added until the deadline (samplesPerPixel is then only an
+        ///        upper limit) and each pixel is normalized by the samples it actually received.
+        ///        The final image is written to stdout.
+        void progressiveRender(const Hittable& world)
+        {
+            init();
+
+            using Clock = std::chrono::high_resolution_clock;
+
+            auto renderStartTime = Clock::now();
+            auto lastSnapshotTime = renderStartTime;
+            auto lastCheckpointTime = renderStartTime;
+            auto deadline = renderStartTime + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(timeBudget));
+            bool hasDeadline = timeBudget > 0.0f;
+
+            const int NUMTHREADS = std::max(1u, std::thread::hardware_concurrency());
+            const int passSamples = std::max(1, samplesPerPass);
+
+            RenderCheckpoint state;
+            state.imageWidth = imageWidth;
+            state.imageHeight = imageHeight;
+            state.samplesPerPixel = samplesPerPixel;
+            state.samplesPerPass = passSamples;
+            state.maxDepth = maxDepth;
+            state.samplerType = int32_t(samplerType);
+            state.seed = seed;
+            state.sceneName = sceneName;
+            state.sceneHash = sceneHash(world);
+            state.cropX0 = cropX0;
+            state.cropY0 = cropY0;
+            state.cropX1 = cropX1;
+            state.cropY1 = cropY1;
+            state.accumulatedColor = std::vector<Color>(cropWidth * cropHeight);
+            state.luminanceSquaredSum = std::vector<float>(cropWidth * cropHeight, 0.0f);
+            state.sampleCounts = std::vector<uint32_t>(cropWidth * cropHeight, 0);
+
+            if (resumeFromCheckpoint && !checkpointFilename.empty())
+            {
+                RenderCheckpoint checkpoint;
+
+                if (!checkpoint.read(checkpointFilename))
+                    std::clog << "No usable checkpoint '" << checkpointFilename << "', starting from scratch.\n";
+                else if (!checkpoint.isCompatible(state))
+                    std::clog << "Checkpoint '" << checkpointFilename << "' was made with different settings, starting from scratch.\n";
+                else
+                    state = checkpoint;
+            }
+
+            int completedSamples = int(*std::min_element(state.sampleCounts.begin(), state.sampleCounts.end()));
+
+            if (completedSamples > 0 && !quiet)
+                std::clog << "Resuming at " << completedSamples << " / " << samplesPerPixel << " spp.\n";
+
+            ProgressReporter progress(uint64_t(cropWidth) * cropHeight * samplesPerPixel, "samples", !quiet);
+            progress.add(std::accumulate(state.sampleCounts.begin(), state.sampleCounts.end(), uint64_t(0)));
+
+            const int passCount = (samplesPerPixel + passSamples - 1) / passSamples;
+            bool deadlineReached = false;
+
+            for (int pass = completedSamples / passSamples; pass < passCount && !deadlineReached; pass++)
             {
-                int startY = i * rowsPerThread;
-                int endY = (i == NUMTHREADS - 1) ? imageHeight : startY + rowsPerThread;
+                std::atomic<int> nextRow = 0;
+                std::atomic<bool> outOfTime = false;
+                std::vector<std::thread> threads;
+
+                auto renderRows = [&]()
+                {
+                    std::unique_ptr<Sampler> sampler = makeSampler(samplerType, samplesPerPixel, seed);
+
+                    for (int y = cropY0 + nextRow++; y < cropY1; y = cropY0 + nextRow++)
+                    {
+                        if (hasDeadline && (outOfTime || Clock::now() >= deadline))
+                        {
+                            outOfTime = true;
+                            return;
+                        }
+
+                        uint64_t rowSamples = 0;
+
+                        for (int x = cropX0; x < cropX1; x++)
+                        {
+                            int pixelIndex = (y - cropY0) * cropWidth + (x - cropX0);
+                            int firstSample = int(state.sampleCounts[pixelIndex]);
+                            int sampleCount = std::min(passSamples, samplesPerPixel - firstSample);
+
+                            if (sampleCount <= 0) continue;
+
+                            state.accumulatedColor[pixelIndex] += samplePixel
+                            (
+                                x, y, firstSample, sampleCount, world, *sampler,
+                                &state.luminanceSquaredSum[pixelIndex]
+                            );
+                            state.sampleCounts[pixelIndex] += sampleCount;
+                            rowSamples += sampleCount;
+                        }
+
+                        progress.add(rowSamples);
+                    }
+                };
+
+                for (int i = 0; i < NUMTHREADS; i++)
+                    threads.emplace_back(renderRows);
+
+                for (auto& thread : threads) thread.join();
 
-                threads.emplace_back(renderChunk, startY, endY);
+                // Snapshot and checkpoint
+                auto currentTime = Clock::now();
+                std::chrono::duration<float> sinceSnapshot = currentTime - lastSnapshotTime;
+                std::chrono::duration<float> sinceCheckpoint = currentTime - lastCheckpointTime;
+
+                deadlineReached = hasDeadline && currentTime >= deadline;
+                bool isLastPass = pass == passCount - 1 || deadlineReached;
+
+                if (!isLastPass && sinceSnapshot.count() >= snapshotInterval)
+                {
+                    writeSnapshot(state.accumulatedColor, state.sampleCounts);
+                    lastSnapshotTime = currentTime;
+                }
+
+                if (!checkpointFilename.empty() && (isLastPass || sinceCheckpoint.count() >= checkpointInterval))
+                {
+                    if (!state.write(checkpointFilename))
+                        std::cerr << "\nError: could not write checkpoint '" << checkpointFilename << "'\n";
+
+                    lastCheckpointTime = currentTime;
+                }
             }
 
-            // Wait for threads
-            for (auto& thread : threads) thread.join();
+            writeImage(std::cout, state.accumulatedColor, state.sampleCounts);
 
-            // Write buffer in correct order
-            for (int y = 0; y < imageHeight; y++)
-                for (int x = 0; x < imageWidth; x++)
-                    writeColor(std::cout, pixelBuffer[y * imageWidth + x]);
-            
-            
-            // Log render time
-            auto renderEndTime = std::chrono::high_resolution_clock::now();
-            std::chrono::duration<float> renderTotalTime = renderEndTime - renderStartTime;
+            progress.stop();
+
+            if (!quiet)
+                logSampleStatistics(state);
+        }
 
-            int renderTotalMinutes = static_cast<int>(renderTotalTime.count()) / 60;
-            int renderTotalSeconds = static_cast<int>(renderTotalTime.count()) % 60;
+        /// @brief The pixels that are traced, as resolved from the crop window settings.
+        PixelRect cropWindow()
+        {
+            init();
+
+            return { cropX0, cropY0, cropX1, cropY1 };
+        }
+
+        /// @brief Trace all samples of the pixels in a tile, for rendering that is split up by the caller.
+        ///        Results only depend on the pixel coordinates, not on how the image was split.
+        /// @param pixels Receives the final pixel colors of the tile, row by row.
+        void renderTile(const Hittable& world, const PixelRect& tile, std::vector<Color>& pixels)
+        {
+            init();
+
+            std::unique_ptr<Sampler> sampler = makeSampler(samplerType, samplesPerPixel, seed);
+            pixels.assign(size_t(tile.width()) * tile.height(), Color(0));
+
+            sampleRect(tile, 0, samplesPerPixel, world, *sampler, pixels.data());
+
+            for (Color& pixel : pixels)
+                pixel = pixelSampleScale * pixel;
+        }
+
+        /// @brief Write an image assembled from tiles, given the final colors of all crop window pixels.
+        void writeCropImage(std::ostream& out, const std::vector<Color>& cropPixels)
+        {
+            init();
 
-            std::clog << "\rDone. Render time: "
-                      << std::setw(2) << std::setfill('0') << renderTotalMinutes << ":"
-                      << std::setw(2) << std::setfill('0') << renderTotalSeconds << ".                   ";
+            writeImage(out, [&](int i) { return cropPixels[i]; });
         }
 };
 
@@ -0,0 +1,171 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+
+// Accumulation state of a progressive render, stored as a binary file in native byte order.
+// Together with deterministic per-sample random streams this is all that is needed to
+// continue a render exactly where it stopped.
+class RenderCheckpoint
+{
+    private:
+        static constexpr char magic[4] = { 'R', 'T', 'C', 'K' };
+        static constexpr uint32_t version = 5;
+        static constexpr uint32_t maxSceneNameLength = 1024;
+
+        template <typename T>
+        static void writeValue(std::ostream& out, const T& value)
+        {
+            out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+
+        template <typename T>
+        static bool readValue(std::istream& in, T& value)
+        {
+            return bool(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+        }
+
+
+    public:
+        // Render settings the accumulated samples depend on; a checkpoint is only resumed if they match.
+        // The buffers cover the crop window [cropX0, cropX1) x [cropY0, cropY1) of the image.
+        int32_t  imageWidth = 0;
+        int32_t  imageHeight = 0;
+        int32_t  samplesPerPixel = 0;
+        int32_t  samplesPerPass = 0;
+        int32_t  maxDepth = 0;
+        int32_t  samplerType = 0;
+        int32_t  cropX0 = 0;
+        int32_t  cropY0 = 0;
+        int32_t  cropX1 = 0;
+        int32_t  cropY1 = 0;
+        uint64_t seed = 0;
+        // What is rendered: the scene's name and a hash of the camera and the world's bounds.
+        std::string sceneName;
+        uint64_t sceneHash = 0;
+
+        std::vector<Color>    accumulatedColor;
+        std::vector<float>    luminanceSquaredSum;  // Per pixel, for noise estimates
+        std::vector<uint32_t> sampleCounts;
+
+
+        bool isCompatible(const RenderCheckpoint& other) const
+        {
+            return imageWidth == other.imageWidth &&
+                   imageHeight == other.imageHeight &&
+                   samplesPerPixel == other.samplesPerPixel &&
+                   samplesPerPass == other.samplesPerPass &&
+                   maxDepth == other.maxDepth &&
+                   samplerType == other.samplerType &&
+                   cropX0 == other.cropX0 && cropY0 == other.cropY0 &&
+                   cropX1 == other.cropX1 && cropY1 == other.cropY1 &&
+                   seed == other.seed &&
+                   sceneName == other.sceneName &&
+                   sceneHash == other.sceneHash;
+        }
+
+        /// @brief Write the checkpoint to a temporary file and rename it, so an interrupted write
+        ///        never replaces a good checkpoint with a broken one.
+        bool write(const std::string& filename) const
+        {
+            std::string temporaryFilename = filename + ".tmp";
+
+            {
+                std::ofstream out(temporaryFilename, std::ios::binary);
+
+                if (!out) return false;
+
+                out.write(magic, sizeof(magic));
+                writeValue(out, version);
+                writeValue(out, imageWidth);
+                writeValue(out, imageHeight);
+                writeValue(out, samplesPerPixel);
+                writeValue(out, samplesPerPass);
+                writeValue(out, maxDepth);
+                writeValue(out, samplerType);
+                writeValue(out, cropX0);
+                writeValue(out, cropY0);
+                writeValue(out, cropX1);
+                writeValue(out, cropY1);
+                writeValue(out, seed);
+
+                uint32_t sceneNameLength = uint32_t(sceneName.size());
+                writeValue(out, sceneNameLength);
+                out.write(sceneName.data(), sceneNameLength);
+                writeValue(out, sceneHash);
+
+                uint64_t pixelCount = accumulatedColor.size();
+                writeValue(out, pixelCount);
+
+                for (const Color& color : accumulatedColor)
+                    out.write(reinterpret_cast<const char*>(color.values), sizeof(color.values));
+
+                out.write(reinterpret_cast<const char*>(luminanceSquaredSum.data()), pixelCount * sizeof(float));
+                out.write(reinterpret_cast<const char*>(sampleCounts.data()), pixelCount * sizeof(uint32_t));
+
+                if (!out) return false;
+            }
+
+            std::error_code error;
+            std::filesystem::rename(temporaryFilename, filename, error);
+
+            return !error;
+        }
+
+        bool read(const std::string& filename)
+        {
+            std::ifstream in(filename, std::ios::binary);
+
+            if (!in) return false;
+
+            char fileMagic[4];
+            uint32_t fileVersion;
+
+            if (!in.read(fileMagic, sizeof(fileMagic)) || std::memcmp(fileMagic, magic, sizeof(magic)) != 0)
+                return false;
+
+            if (!readValue(in, fileVersion) || fileVersion != version)
+                return false;
+
+            uint32_t sceneNameLength;
+            uint64_t pixelCount;
+
+            if (!readValue(in, imageWidth) || !readValue(in, imageHeight) ||
+                !readValue(in, samplesPerPixel) || !readValue(in, samplesPerPass) ||
+                !readValue(in, maxDepth) || !readValue(in, samplerType) ||
+                !readValue(in, cropX0) || !readValue(in, cropY0) ||
+                !readValue(in, cropX1) || !readValue(in, cropY1) ||
+                !readValue(in, seed) ||
+                !readValue(in, sceneNameLength) || sceneNameLength > maxSceneNameLength)
+                return false;
+
+            sceneName.resize(sceneNameLength);
+
+            if (!in.read(sceneName.data(), sceneNameLength) || !readValue(in, sceneHash) || !readValue(in, pixelCount))
+                return false;
+
+            if (pixelCount != uint64_t(cropX1 - cropX0) * uint64_t(cropY1 - cropY0))
+                return false;
+
+            accumulatedColor = std::vector<Color>(pixelCount);
+            luminanceSquaredSum = std::vector<float>(pixelCount);
+            sampleCounts = std::vector<uint32_t>(pixelCount);
+
+            for (Color& color : accumulatedColor)
+                in.read(reinterpret_cast<char*>(color.values), sizeof(color.values));
+
+            in.read(reinterpret_cast<char*>(luminanceSquaredSum.data()), pixelCount * sizeof(float));
+            in.read(reinterpret_cast<char*>(sampleCounts.data()), pixelCount * sizeof(uint32_t));
+
+            return bool(in);
+        }
+};
+
+
+#endif
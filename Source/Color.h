@@ -7,6 +7,12 @@
 using Color = Vector3;
 
 
+inline float luminance(const Color& color)
+{
+    return 0.2126f * color.x() + 0.7152f * color.y() + 0.0722f * color.z();
+}
+
+
 inline float linear2gamma(float linearValue)
 {
     if (linearValue > 0.0f)
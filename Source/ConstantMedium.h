@@ -12,46 +12,53 @@ class ConstantMedium : public Hittable
         shared_ptr<Hittable> boundary;
         shared_ptr<Material> phaseFunction;
         float negativeInverseDensity;
-    
-    
-    public:
-        ConstantMedium(shared_ptr<Hittable> boundary, shared_ptr<Texture> tex, float density)
-        : boundary(boundary), negativeInverseDensity(-1.0f / density),
-          phaseFunction(make_shared<Isotropic>(tex)) {}
-        
-        ConstantMedium(shared_ptr<Hittable> boundary, const Color& albedo, float density)
-        : boundary(boundary), negativeInverseDensity(-1.0f / density),
-          phaseFunction(make_shared<Isotropic>(albedo)) {}
 
-        
-        bool hit(const Ray& ray, Interval rayT, HitRecord& record) const override
-        {
-            HitRecord record1;
-            HitRecord record2;
 
-            if (!boundary->hit(ray, Interval::universe, record1))
-                return false;
+        /// @brief Sample where the ray scatters inside the medium, within rayT.
+        bool sampleCollision(const Ray& ray, Interval rayT, float& t) const
+        {
+            Interval inside;
 
-            if (!boundary->hit(ray, Interval(record1.t + 0.0001f, infinity), record2))
+            if (!boundary->entryExitInterval(ray, inside))
                 return false;
             
-            if (record1.t < rayT.min) record1.t = rayT.min;
-            if (record2.t > rayT.max) record2.t = rayT.max;
+            if (inside.min < rayT.min) inside.min = rayT.min;
+            if (inside.max > rayT.max) inside.max = rayT.max;
 
-            if (record1.t >= record2.t)
+            if (inside.min >= inside.max)
                 return false;
             
-            if (record1.t < 0) record1.t = 0;
+            if (inside.min < 0) inside.min = 0;
 
 
             float rayLength = ray.direction().magnitude();
-            float distanceInsideBounds = (record2.t - record1.t) * rayLength;
+            float distanceInsideBounds = (inside.max - inside.min) * rayLength;
             float hitDistance = negativeInverseDensity * std::log(randomFloat());
 
             if (hitDistance > distanceInsideBounds)
                 return false;
             
-            record.t = record1.t + hitDistance / rayLength;
+            t = inside.min + hitDistance / rayLength;
+
+            return true;
+        }
+    
+    
+    public:
+        ConstantMedium(shared_ptr<Hittable> boundary, shared_ptr<Texture> tex, float density)
+        : boundary(boundary), negativeInverseDensity(-1.0f / density),
+          phaseFunction(make_shared<Isotropic>(tex)) {}
+        
+        ConstantMedium(shared_ptr<Hittable> boundary, const Color& albedo, float density)
+        : boundary(boundary), negativeInverseDensity(-1.0f / density),
+          phaseFunction(make_shared<Isotropic>(albedo)) {}
+
+        
+        bool hit(const Ray& ray, Interval rayT, HitRecord& record) const override
+        {
+            if (!sampleCollision(ray, rayT, record.t))
+                return false;
+            
             record.p = ray.at(record.t);
             record.normal = Vector3(1, 0, 0);
             record.isFrontFace = true;
@@ -60,7 +67,19 @@ class ConstantMedium : public Hittable
             return true;
         }
 
+        /// @brief Whether a sampled collision blocks the ray, as a hit() would.
+        bool occluded(const Ray& ray, Interval rayT) const override
+        {
+            float t;
+
+            return sampleCollision(ray, rayT, t);
+        }
+
         AAlignedBBox boundingBox() const override { return boundary->boundingBox(); }
+
+        AAlignedBBox boundingBoxAt(float time) const override { return boundary->boundingBoxAt(time); }
+
+        void refit() override { boundary->refit(); }
 };
 
 
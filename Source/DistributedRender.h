@@ -0,0 +1,504 @@
+#ifndef DISTRIBUTEDRENDER_H
+#define DISTRIBUTEDRENDER_H
+
+#include "Camera.h"
+#include "Hittable.h"
+#include "Network.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iomanip>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// Tile render protocol. All values are sent in native byte order, so coordinator and workers
+// have to run on machines of the same endianness.
+//
+//  coordinator -> worker   Job         protocol version, scene name, render settings
+//  worker -> coordinator   Ready       or Error with a message
+//  coordinator -> worker   Tile        pixel rectangle to render
+//  worker -> coordinator   TileResult  pixel rectangle, then width * height RGB floats
+//  coordinator -> worker   Done        no more tiles; the worker closes the connection
+enum class RenderMessage : uint32_t
+{
+    Job = 1,
+    Ready,
+    Error,
+    Tile,
+    TileResult,
+    Done
+};
+
+constexpr uint32_t renderProtocolVersion = 2;
+
+static_assert(sizeof(Color) == 3 * sizeof(float), "Tile data is sent as packed RGB floats");
+
+
+// Settings a worker's camera has to share with the coordinator for the tiles to fit together.
+struct RenderJobSettings
+{
+    int32_t imageWidth;
+    int32_t samplesPerPixel;
+    int32_t maxDepth;
+    int32_t samplerType;
+    uint64_t seed;
+
+    static RenderJobSettings fromCamera(const Camera& cam)
+    {
+        return { cam.imageWidth, cam.samplesPerPixel, cam.maxDepth, int32_t(cam.samplerType), cam.seed };
+    }
+
+    bool operator==(const RenderJobSettings& other) const
+    {
+        return imageWidth == other.imageWidth && samplesPerPixel == other.samplesPerPixel &&
+               maxDepth == other.maxDepth && samplerType == other.samplerType && seed == other.seed;
+    }
+};
+
+
+inline bool sendString(const Socket& socket, const std::string& text)
+{
+    return socket.sendValue(uint32_t(text.size())) && socket.sendAll(text.data(), text.size());
+}
+
+inline bool receiveString(const Socket& socket, std::string& text, uint32_t maxLength = 4096)
+{
+    uint32_t length;
+
+    if (!socket.receiveValue(length) || length > maxLength)
+        return false;
+
+    text.resize(length);
+
+    return socket.receiveAll(text.data(), length);
+}
+
+inline bool sendRect(const Socket& socket, const PixelRect& rect)
+{
+    int32_t values[4] = { rect.x0, rect.y0, rect.x1, rect.y1 };
+
+    return socket.sendAll(values, sizeof(values));
+}
+
+inline bool receiveRect(const Socket& socket, PixelRect& rect)
+{
+    int32_t values[4];
+
+    if (!socket.receiveAll(values, sizeof(values)))
+        return false;
+
+    rect = { values[0], values[1], values[2], values[3] };
+
+    return true;
+}
+
+
+// Hands out the tiles of a frame to worker processes that connect over TCP and assembles the
+// returned pixels. Pixel values only depend on their coordinates, so the image is the same
+// no matter how many workers take part or which worker renders which tile. Tiles of workers
+// that disconnect or stop answering are handed out again.
+class RenderCoordinator
+{
+    private:
+        std::string sceneName;
+        Camera      cam;
+        uint16_t    port;
+
+        std::mutex              mutex;
+        std::condition_variable tileAvailable;
+        std::deque<PixelRect>   pendingTiles;
+        int                     completedTiles = 0;
+        int                     totalTiles = 0;
+        int                     connectedWorkers = 0;
+        PixelRect               crop;
+        std::vector<Color>      cropPixels;
+        // Connections of all workers, owned here so the frame can end them when it is done. A deque
+        // keeps them in place while more are added.
+        std::deque<Socket>      workerSockets;
+
+        std::chrono::high_resolution_clock::time_point renderStartTime;
+
+
+        bool isFinished() const { return completedTiles == totalTiles; }
+
+        void logProgress() const
+        {
+            if (cam.quiet) return;
+
+            std::chrono::duration<float> elapsedTime = std::chrono::high_resolution_clock::now() - renderStartTime;
+            int minutes = static_cast<int>(elapsedTime.count()) / 60;
+            int seconds = static_cast<int>(elapsedTime.count()) % 60;
+
+            std::clog << "\rProcessing... "
+                      << std::fixed << std::setprecision(2) << 100.0f * completedTiles / totalTiles << "% "
+                      << "(" << completedTiles << " / " << totalTiles << " tiles) "
+                      << std::setw(2) << std::setfill('0') << minutes << ":"
+                      << std::setw(2) << std::setfill('0') << seconds << " elapsed. ("
+                      << connectedWorkers << " workers connected)       "
+                      << std::flush;
+        }
+
+        static bool sendTile(const Socket& worker, const PixelRect& tile)
+        {
+            return worker.sendValue(RenderMessage::Tile) && sendRect(worker, tile);
+        }
+
+        /// @brief Send the job to a worker and wait for it to be accepted.
+        bool startJob(const Socket& worker)
+        {
+            RenderJobSettings settings = RenderJobSettings::fromCamera(cam);
+            RenderMessage reply;
+
+            if (!worker.sendValue(RenderMessage::Job) || !worker.sendValue(renderProtocolVersion) ||
+                !sendString(worker, sceneName) || !worker.sendValue(settings) ||
+                !worker.receiveValue(reply))
+                return false;
+
+            if (reply == RenderMessage::Error)
+            {
+                std::string message;
+
+                if (receiveString(worker, message))
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    std::cerr << "\nWorker rejected the job: " << message << "\n";
+                }
+
+                return false;
+            }
+
+            return reply == RenderMessage::Ready;
+        }
+
+        /// @brief Feed tiles to one worker until the frame is done, the connection breaks or the worker
+        ///        stops answering for replyTimeout milliseconds.
+        void serveWorker(Socket& worker)
+        {
+            worker.setReceiveTimeout(replyTimeout);
+
+            if (!startJob(worker))
+                return;
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                connectedWorkers++;
+                logProgress();
+            }
+
+            std::vector<Color> pixels;
+
+            while (true)
+            {
+                PixelRect tile;
+
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    tileAvailable.wait(lock, [&]() { return !pendingTiles.empty() || isFinished(); });
+
+                    if (isFinished())
+                    {
+                        connectedWorkers--;
+                        worker.sendValue(RenderMessage::Done);
+                        return;
+                    }
+
+                    tile = pendingTiles.front();
+                    pendingTiles.pop_front();
+                }
+
+                RenderMessage reply;
+                PixelRect result;
+                pixels.resize(size_t(tile.width()) * tile.height());
+
+                bool received = sendTile(worker, tile) &&
+                                worker.receiveValue(reply) && reply == RenderMessage::TileResult &&
+                                receiveRect(worker, result) &&
+                                result.x0 == tile.x0 && result.y0 == tile.y0 && result.x1 == tile.x1 && result.y1 == tile.y1 &&
+                                worker.receiveAll(pixels.data(), pixels.size() * sizeof(Color));
+
+                std::lock_guard<std::mutex> lock(mutex);
+
+                if (!received)
+                {
+                    connectedWorkers--;
+
+                    // The frame may have been finished by others while this worker was cut off.
+                    if (isFinished())
+                        return;
+
+                    // Give the tile to another worker. A worker that merely stalled must not send it
+                    // late, so its connection is ended.
+                    worker.shutdown();
+                    pendingTiles.push_front(tile);
+                    tileAvailable.notify_one();
+                    std::cerr << "\nLost a worker, its tile is rendered again.\n";
+                    return;
+                }
+
+                for (int y = tile.y0; y < tile.y1; y++)
+                    for (int x = tile.x0; x < tile.x1; x++)
+                        cropPixels[(y - crop.y0) * crop.width() + (x - crop.x0)] = pixels[(y - tile.y0) * tile.width() + (x - tile.x0)];
+
+                completedTiles++;
+                logProgress();
+
+                if (isFinished())
+                    tileAvailable.notify_all();
+            }
+        }
+
+
+    public:
+        int tileSize = 32;
+        int replyTimeout = 120000;  // Milliseconds to wait for a worker to accept the job or return a tile
+
+        /// @param sceneName Name the workers build their scene from; it has to describe the same scene as cam.
+        RenderCoordinator(const std::string& sceneName, const Camera& cam, uint16_t port)
+        : sceneName(sceneName), cam(cam), port(port) {}
+
+        /// @brief Listen for workers, distribute the crop window of the frame among them and write the
+        ///        assembled image once every tile is back.
+        /// @return False if the port could not be opened.
+        bool render(std::ostream& out)
+        {
+            Socket server = Socket::listen(port);
+
+            if (!server.isValid())
+            {
+                std::cerr << "Error: could not listen on port " << port << "\n";
+                return false;
+            }
+
+            renderStartTime = std::chrono::high_resolution_clock::now();
+
+            crop = cam.cropWindow();
+            cropPixels = std::vector<Color>(size_t(crop.width()) * crop.height());
+
+            int size = std::max(1, tileSize);
+
+            for (int y = crop.y0; y < crop.y1; y += size)
+                for (int x = crop.x0; x < crop.x1; x += size)
+                    pendingTiles.push_back({ x, y, std::min(x + size, crop.x1), std::min(y + size, crop.y1) });
+
+            totalTiles = int(pendingTiles.size());
+
+            if (!cam.quiet)
+                std::clog << "Waiting for workers on port " << port << "...\n";
+
+            std::vector<std::thread> workerThreads;
+
+            while (true)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+
+                    if (isFinished()) break;
+                }
+
+                Socket worker = server.accept(200);
+
+                if (worker.isValid())
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    workerSockets.push_back(std::move(worker));
+                    workerThreads.emplace_back(&RenderCoordinator::serveWorker, this, std::ref(workerSockets.back()));
+                }
+            }
+
+            cam.writeCropImage(out, cropPixels);
+            out.flush();
+
+            // Connections still waiting for a reply, e.g. from a client that never took the job,
+            // would otherwise hold up the end of the render.
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+
+                for (const Socket& worker : workerSockets)
+                    worker.shutdown();
+            }
+
+            for (auto& thread : workerThreads) thread.join();
+
+            workerSockets.clear();
+
+            std::chrono::duration<float> renderTotalTime = std::chrono::high_resolution_clock::now() - renderStartTime;
+            int renderTotalMinutes = static_cast<int>(renderTotalTime.count()) / 60;
+            int renderTotalSeconds = static_cast<int>(renderTotalTime.count()) % 60;
+
+            if (!cam.quiet)
+                std::clog << "\rDone. Render time: "
+                          << std::setw(2) << std::setfill('0') << renderTotalMinutes << ":"
+                          << std::setw(2) << std::setfill('0') << renderTotalSeconds << ".                   ";
+
+            return true;
+        }
+};
+
+
+// Connects to a coordinator and renders the tiles it is given. The scene is built locally
+// from the name sent with the job. Every connection renders one tile at a time, so a worker
+// process opens one connection per thread it should use.
+class RenderWorker
+{
+    public:
+        /// @brief Builds the scene with the given name; returns false for unknown names.
+        using SceneBuilder = std::function<bool(const std::string& sceneName, shared_ptr<Hittable>& world, Camera& cam)>;
+
+
+    private:
+        std::string  host;
+        uint16_t     port;
+        SceneBuilder buildScene;
+
+        // The scene of the current job, shared by all connections of this process.
+        std::mutex           sceneMutex;
+        std::string          builtSceneName;
+        shared_ptr<Hittable> world;
+        Camera               sceneCamera;
+
+        std::atomic<bool>    jobFinished = false;
+
+
+        bool prepareScene(const std::string& sceneName, std::string& error)
+        {
+            std::lock_guard<std::mutex> lock(sceneMutex);
+
+            if (world != nullptr && builtSceneName == sceneName)
+                return true;
+
+            world = nullptr;
+
+            if (!buildScene(sceneName, world, sceneCamera) || world == nullptr)
+            {
+                error = "unknown scene '" + sceneName + "'";
+                return false;
+            }
+
+            builtSceneName = sceneName;
+
+            return true;
+        }
+
+        bool acceptJob(const Socket& coordinator, Camera& cam, shared_ptr<Hittable>& jobWorld)
+        {
+            RenderMessage message;
+            uint32_t version;
+            std::string sceneName;
+            RenderJobSettings settings;
+
+            if (!coordinator.receiveValue(message) || message != RenderMessage::Job ||
+                !coordinator.receiveValue(version) || version != renderProtocolVersion ||
+                !receiveString(coordinator, sceneName) || !coordinator.receiveValue(settings))
+                return false;
+
+            std::string error;
+
+            if (prepareScene(sceneName, error))
+            {
+                std::lock_guard<std::mutex> lock(sceneMutex);
+                cam = sceneCamera;
+                cam.seed = settings.seed;
+                jobWorld = world;
+
+                if (!(RenderJobSettings::fromCamera(cam) == settings))
+                    error = "render settings of scene '" + sceneName + "' differ from the coordinator's";
+            }
+
+            if (!error.empty())
+            {
+                std::cerr << "Error: " << error << "\n";
+                coordinator.sendValue(RenderMessage::Error);
+                sendString(coordinator, error);
+                return false;
+            }
+
+            return coordinator.sendValue(RenderMessage::Ready);
+        }
+
+        /// @return The number of tiles rendered on this connection.
+        int serveConnection()
+        {
+            Socket coordinator;
+
+            // The coordinator may not be up yet.
+            for (int attempt = 0; attempt < connectAttempts && !coordinator.isValid() && !jobFinished; attempt++)
+            {
+                coordinator = Socket::connect(host, port);
+
+                if (!coordinator.isValid())
+                    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+            }
+
+            Camera cam;
+            shared_ptr<Hittable> jobWorld;
+
+            if (!coordinator.isValid() || !acceptJob(coordinator, cam, jobWorld))
+                return 0;
+
+            std::vector<Color> pixels;
+            int renderedTiles = 0;
+
+            while (true)
+            {
+                RenderMessage message;
+                PixelRect tile;
+
+                if (!coordinator.receiveValue(message))
+                    break;
+
+                if (message == RenderMessage::Done)
+                {
+                    jobFinished = true;
+                    break;
+                }
+
+                if (message != RenderMessage::Tile || !receiveRect(coordinator, tile))
+                    break;
+
+                cam.renderTile(*jobWorld, tile, pixels);
+
+                if (!coordinator.sendValue(RenderMessage::TileResult) || !sendRect(coordinator, tile) ||
+                    !coordinator.sendAll(pixels.data(), pixels.size() * sizeof(Color)))
+                    break;
+
+                renderedTiles++;
+            }
+
+            return renderedTiles;
+        }
+
+
+    public:
+        int connectAttempts = 60;  // Attempts, half a second apart, to reach the coordinator
+        bool quiet = false;        // No summary output; errors are still reported
+
+        RenderWorker(const std::string& host, uint16_t port, SceneBuilder buildScene)
+        : host(host), port(port), buildScene(buildScene) {}
+
+        /// @brief Serve the coordinator over the given number of connections until it is done.
+        /// @return The number of tiles rendered.
+        int run(int connections)
+        {
+            std::vector<std::thread> threads;
+            std::atomic<int> renderedTiles = 0;
+
+            for (int i = 0; i < std::max(1, connections); i++)
+                threads.emplace_back([&]() { renderedTiles += serveConnection(); });
+
+            for (auto& thread : threads) thread.join();
+
+            if (!quiet)
+                std::clog << "Worker done, rendered " << renderedTiles << " tiles.\n";
+
+            return renderedTiles;
+        }
+};
+
+
+#endif
@@ -0,0 +1,287 @@
+#ifndef HETEROGENEOUSMEDIUM_H
+#define HETEROGENEOUSMEDIUM_H
+
+#include "Hittable.h"
+#include "Material.h"
+#include "Texture.h"
+#include "VoxelGrid.h"
+
+#include <algorithm>
+#include <vector>
+
+
+// Participating medium with a spatially varying density stored in a VoxelGrid.
+// Free-flight distances are sampled with delta tracking against a coarse grid of
+// per-cell density maxima (majorants), so empty regions are crossed in one step.
+class HeterogeneousMedium : public Hittable
+{
+    private:
+        shared_ptr<Hittable> boundary;
+        shared_ptr<Material> phaseFunction;
+        VoxelGrid density;
+
+        // Each majorant cell covers majorantCellSize x majorantCellSize x majorantCellSize density cells.
+        int majorantCellSize;
+        int majorantResX;
+        int majorantResY;
+        int majorantResZ;
+        Vector3 majorantCellExtent;
+        std::vector<float> majorants;
+
+
+        void buildMajorantGrid()
+        {
+            majorantResX = (density.resolutionX() - 2) / majorantCellSize + 1;
+            majorantResY = (density.resolutionY() - 2) / majorantCellSize + 1;
+            majorantResZ = (density.resolutionZ() - 2) / majorantCellSize + 1;
+            majorantCellExtent = float(majorantCellSize) * density.cellSize();
+            majorants = std::vector<float>(size_t(majorantResX) * majorantResY * majorantResZ, 0.0f);
+
+            // Trilinear interpolation never exceeds its corner values, so the maximum over
+            // the lattice points of a cell bounds the density everywhere inside it.
+            for (int k = 0; k < density.resolutionZ(); k++)
+                for (int j = 0; j < density.resolutionY(); j++)
+                    for (int i = 0; i < density.resolutionX(); i++)
+                    {
+                        float value = density.at(i, j, k);
+
+                        int cellsX[2] = { std::min(i / majorantCellSize, majorantResX - 1), (i - 1) / majorantCellSize };
+                        int cellsY[2] = { std::min(j / majorantCellSize, majorantResY - 1), (j - 1) / majorantCellSize };
+                        int cellsZ[2] = { std::min(k / majorantCellSize, majorantResZ - 1), (k - 1) / majorantCellSize };
+
+                        // Lattice points on a cell border contribute to the cells on both sides.
+                        for (int a = 0; a < 2; a++)
+                            for (int b = 0; b < 2; b++)
+                                for (int c = 0; c < 2; c++)
+                                {
+                                    if ((a == 1 && i == 0) || (b == 1 && j == 0) || (c == 1 && k == 0)) continue;
+
+                                    float& majorant = majorantAt(cellsX[a], cellsY[b], cellsZ[c]);
+                                    majorant = std::fmax(majorant, value);
+                                }
+                    }
+        }
+
+        float& majorantAt(int i, int j, int k) { return majorants[(size_t(k) * majorantResY + j) * majorantResX + i]; }
+        float majorantAt(int i, int j, int k) const { return majorants[(size_t(k) * majorantResY + j) * majorantResX + i]; }
+
+        /// @brief Walk the majorant cells pierced by the ray between tMin and tMax (3D-DDA).
+        /// @param visitCell Called with (cellTMin, cellTMax, majorant); returning false stops the walk.
+        template <typename F>
+        void traverseMajorants(const Ray& ray, float tMin, float tMax, F visitCell) const
+        {
+            const AAlignedBBox& bounds = density.boundingBox();
+            const int resolution[3] = { majorantResX, majorantResY, majorantResZ };
+
+            Point3 entry = ray.at(tMin);
+            int cell[3];
+            int step[3];
+            float tNext[3];
+            float tDelta[3];
+
+            for (int axis = 0; axis < 3; axis++)
+            {
+                const Interval& ax = bounds.axisInterval(axis);
+                float direction = ray.direction()[axis];
+
+                cell[axis] = int((entry[axis] - ax.min) / majorantCellExtent[axis]);
+                cell[axis] = std::clamp(cell[axis], 0, resolution[axis] - 1);
+
+                if (direction > 0)
+                {
+                    step[axis] = 1;
+                    tNext[axis] = tMin + (ax.min + (cell[axis] + 1) * majorantCellExtent[axis] - entry[axis]) / direction;
+                    tDelta[axis] = majorantCellExtent[axis] / direction;
+                }
+                else if (direction < 0)
+                {
+                    step[axis] = -1;
+                    tNext[axis] = tMin + (ax.min + cell[axis] * majorantCellExtent[axis] - entry[axis]) / direction;
+                    tDelta[axis] = -majorantCellExtent[axis] / direction;
+                }
+                else
+                {
+                    step[axis] = 0;
+                    tNext[axis] = infinity;
+                    tDelta[axis] = infinity;
+                }
+            }
+
+            float t = tMin;
+
+            while (t < tMax)
+            {
+                int exitAxis = (tNext[0] < tNext[1])
+                             ? (tNext[0] < tNext[2] ? 0 : 2)
+                             : (tNext[1] < tNext[2] ? 1 : 2);
+
+                float cellExit = std::fmin(tNext[exitAxis], tMax);
+
+                if (!visitCell(t, cellExit, majorantAt(cell[0], cell[1], cell[2])))
+                    return;
+
+                t = cellExit;
+                cell[exitAxis] += step[exitAxis];
+                tNext[exitAxis] += tDelta[exitAxis];
+
+                if (cell[exitAxis] < 0 || cell[exitAxis] >= resolution[exitAxis])
+                    return;
+            }
+        }
+
+        /// @brief Find the part of the ray inside both the boundary and the density grid.
+        bool mediumInterval(const Ray& ray, Interval rayT, Interval& inside) const
+        {
+            Interval boundaryT;
+
+            if (!boundary->entryExitInterval(ray, boundaryT))
+                return false;
+
+            inside = Interval(std::fmax(std::fmax(boundaryT.min, rayT.min), 0.0f), std::fmin(boundaryT.max, rayT.max));
+
+            // Clip against the grid bounds; there is no density outside of them.
+            const AAlignedBBox& bounds = density.boundingBox();
+
+            for (int axis = 0; axis < 3; axis++)
+            {
+                const Interval& ax = bounds.axisInterval(axis);
+                float adinv = 1.0f / ray.direction()[axis];
+
+                float t0 = (ax.min - ray.origin()[axis]) * adinv;
+                float t1 = (ax.max - ray.origin()[axis]) * adinv;
+
+                if (t0 > t1) std::swap(t0, t1);
+
+                inside.min = std::fmax(inside.min, t0);
+                inside.max = std::fmin(inside.max, t1);
+            }
+
+            return inside.min < inside.max;
+        }
+
+        /// @brief Sample where the ray scatters inside the medium, within rayT.
+        bool sampleCollision(const Ray& ray, Interval rayT, float& collisionT) const
+        {
+            Interval inside;
+
+            if (!mediumInterval(ray, rayT, inside))
+                return false;
+
+            float rayLength = ray.direction().magnitude();
+            bool scattered = false;
+
+            // Delta tracking: sample tentative collisions against the cell majorant and
+            // accept them with probability density / majorant.
+            traverseMajorants(ray, inside.min, inside.max, [&](float cellTMin, float cellTMax, float majorant)
+            {
+                if (majorant <= 0.0f) return true;
+
+                float t = cellTMin;
+
+                while (true)
+                {
+                    t -= std::log(1.0f - randomFloat()) / (majorant * rayLength);
+
+                    if (t >= cellTMax) return true;
+
+                    if (randomFloat() * majorant < density.sample(ray.at(t)))
+                    {
+                        scattered = true;
+                        collisionT = t;
+                        return false;
+                    }
+                }
+            });
+
+            return scattered;
+        }
+
+
+    public:
+        /// @brief Medium with densities taken from a grid, e.g. filled from a 3D array via VoxelGrid::at().
+        /// @param majorantCellSize Number of density cells per majorant cell along each axis.
+        HeterogeneousMedium(shared_ptr<Hittable> boundary, const VoxelGrid& density, const Color& albedo, int majorantCellSize = 8)
+        : boundary(boundary), phaseFunction(make_shared<Isotropic>(albedo)), density(density),
+          majorantCellSize(std::max(1, majorantCellSize))
+        {
+            buildMajorantGrid();
+        }
+
+        /// @brief Medium with densities baked from a texture (e.g. a NoiseTexture) over the boundary's bounding box.
+        /// @param densityScale Density for a texture value of 1.
+        /// @param resolution Number of density grid points per axis.
+        HeterogeneousMedium
+        (
+            shared_ptr<Hittable> boundary,
+            shared_ptr<Texture> densityTexture,
+            float densityScale,
+            int resolution,
+            const Color& albedo,
+            int majorantCellSize = 8
+        )
+        : boundary(boundary), phaseFunction(make_shared<Isotropic>(albedo)),
+          density(boundary->boundingBox(), resolution), majorantCellSize(std::max(1, majorantCellSize))
+        {
+            density.fill([&](const Point3& p) { return densityScale * densityTexture->value(0, 0, p).x(); });
+
+            buildMajorantGrid();
+        }
+
+
+        bool hit(const Ray& ray, Interval rayT, HitRecord& record) const override
+        {
+            if (!sampleCollision(ray, rayT, record.t))
+                return false;
+
+            record.p = ray.at(record.t);
+            record.normal = Vector3(1, 0, 0);
+            record.isFrontFace = true;
+            record.mat = phaseFunction;
+
+            return true;
+        }
+
+        /// @brief Whether a sampled collision blocks the ray, as a hit() would. For a smooth shadow
+        ///        estimate use transmittance() instead.
+        bool occluded(const Ray& ray, Interval rayT) const override
+        {
+            float t;
+
+            return sampleCollision(ray, rayT, t);
+        }
+
+        /// @brief Estimate the transmittance along the ray with ratio tracking.
+        float transmittance(const Ray& ray, Interval rayT) const
+        {
+            Interval inside;
+
+            if (!mediumInterval(ray, rayT, inside))
+                return 1.0f;
+
+            float rayLength = ray.direction().magnitude();
+            float T = 1.0f;
+
+            traverseMajorants(ray, inside.min, inside.max, [&](float cellTMin, float cellTMax, float majorant)
+            {
+                if (majorant <= 0.0f) return true;
+
+                float t = cellTMin;
+
+                while (true)
+                {
+                    t -= std::log(1.0f - randomFloat()) / (majorant * rayLength);
+
+                    if (t >= cellTMax) return true;
+
+                    T *= 1.0f - density.sample(ray.at(t)) / majorant;
+                }
+            });
+
+            return T;
+        }
+
+        AAlignedBBox boundingBox() const override { return boundary->boundingBox(); }
+};
+
+
+#endif
@@ -2,6 +2,7 @@
 #define HITTABLE_H
 
 #include "AAlignedBBox.h"
+#include "RayPacket.h"
 
 
 class Material;
@@ -34,6 +35,72 @@ class Hittable
         virtual bool hit(const Ray& ray, Interval rayT, HitRecord& record) const = 0;
 
         virtual AAlignedBBox boundingBox() const = 0;
+
+        /// @brief Bounding box at a time in [0, 1]. A moving object's true bounds must stay within the
+        ///        linear interpolation of its boxes at 0 and 1, which the BVH uses for rays in between.
+        ///        The default, for static objects, is boundingBox().
+        virtual AAlignedBBox boundingBoxAt(float /*time*/) const { return boundingBox(); }
+
+        /// @brief Recompute cached bounds after objects below this one were moved (see Translate::setOffset
+        ///        and RotateY::setAngle), bottom-up. Objects that cache nothing have nothing to do.
+        virtual void refit() {}
+
+        /// @brief Whether a BVH may cut the object at a plane and reference it from both sides, testing
+        ///        the whole object on either side. Requires a static object whose hit() draws no random
+        ///        numbers, so testing it twice gives the same answer.
+        virtual bool supportsSpatialSplits() const { return false; }
+
+        /// @brief Any-hit query for shadow and visibility rays: whether anything is hit within rayT.
+        ///        Returns at the first hit found and computes no surface attributes. The default
+        ///        falls back to hit().
+        virtual bool occluded(const Ray& ray, Interval rayT) const
+        {
+            HitRecord record;
+
+            return hit(ray, rayT, record);
+        }
+
+        /// @brief Intersect the active rays of a packet, each within (tMin, closest[i]). For every ray that
+        ///        hits, closest[i], records[i] and hits[i] are updated, exactly as hit() would for that ray.
+        ///        The default traces the rays one by one, each with its own random stream.
+        virtual void hitPacket(RayPacket& packet, const bool* active, float tMin, float* closest, HitRecord* records, bool* hits) const
+        {
+            for (int i = 0; i < packet.size; i++)
+            {
+                if (!active[i]) continue;
+
+                std::swap(threadRandomGenerator, packet.generators[i]);
+
+                if (hit(packet.rays[i], Interval(tMin, closest[i]), records[i]))
+                {
+                    closest[i] = records[i].t;
+                    hits[i] = true;
+                }
+
+                std::swap(threadRandomGenerator, packet.generators[i]);
+            }
+        }
+
+        /// @brief Find where the ray's line enters and leaves a closed object, without computing surface attributes.
+        ///        Used by volumes to find the part of a ray inside their boundary.
+        /// @param ray The ray to test; the whole line through it is considered, including negative t.
+        /// @param interval Set to the entry and exit t on success.
+        /// @return false if the line does not pass through the object.
+        virtual bool entryExitInterval(const Ray& ray, Interval& interval) const
+        {
+            HitRecord record1;
+            HitRecord record2;
+
+            if (!hit(ray, Interval::universe, record1))
+                return false;
+
+            if (!hit(ray, Interval(record1.t + 0.0001f, infinity), record2))
+                return false;
+
+            interval = Interval(record1.t, record2.t);
+
+            return true;
+        }
 };
 
 
@@ -49,6 +116,13 @@ class Translate : public Hittable
         Translate(shared_ptr<Hittable> obj, const Vector3& offset)
         : hittableObject(obj), offset(offset) { bbox = hittableObject->boundingBox() + offset; }
 
+        /// @brief Move the object, e.g. for the next frame of an animation. Containers above it need a refit().
+        void setOffset(const Vector3& newOffset)
+        {
+            offset = newOffset;
+            bbox = hittableObject->boundingBox() + offset;
+        }
+
         bool hit(const Ray& ray, Interval rayT, HitRecord& record) const override
         {
             Ray rayOffset = Ray(ray.origin() - offset, ray.direction(), ray.time());
@@ -61,7 +135,27 @@ class Translate : public Hittable
             return true;
         }
 
+        bool occluded(const Ray& ray, Interval rayT) const override
+        {
+            return hittableObject->occluded(Ray(ray.origin() - offset, ray.direction(), ray.time()), rayT);
+        }
+
+        bool entryExitInterval(const Ray& ray, Interval& interval) const override
+        {
+            return hittableObject->entryExitInterval(Ray(ray.origin() - offset, ray.direction(), ray.time()), interval);
+        }
+
         AAlignedBBox boundingBox() const override { return bbox; }
+
+        AAlignedBBox boundingBoxAt(float time) const override { return hittableObject->boundingBoxAt(time) + offset; }
+
+        bool supportsSpatialSplits() const override { return hittableObject->supportsSpatialSplits(); }
+
+        void refit() override
+        {
+            hittableObject->refit();
+            bbox = hittableObject->boundingBox() + offset;
+        }
 };
 
 
@@ -72,18 +166,29 @@ class RotateY : public Hittable
         float sinTheta;
         float cosTheta;
         AAlignedBBox bbox;
-    
 
-    public:
-        RotateY(shared_ptr<Hittable> obj, float angle) : hittableObject(obj)
+        Ray rotateRay(const Ray& ray) const
         {
-            float radians = deg2rad(angle);
+            Point3 origin = Point3
+            (
+                (cosTheta * ray.origin().x()) - (sinTheta * ray.origin().z()),
+                ray.origin().y(),
+                (sinTheta * ray.origin().x()) + (cosTheta * ray.origin().z())
+            );
 
-            sinTheta = std::sinf(radians);
-            cosTheta = std::cosf(radians);
+            Vector3 direction = Vector3
+            (
+                (cosTheta * ray.direction().x()) - (sinTheta * ray.direction().z()),
+                ray.direction().y(),
+                (sinTheta * ray.direction().x()) + (cosTheta * ray.direction().z())
+            );
 
-            bbox = hittableObject->boundingBox();
+            return Ray(origin, direction, ray.time());
+        }
 
+        /// @brief Box around the rotated corners of a box of the unrotated object.
+        AAlignedBBox rotatedBox(const AAlignedBBox& bbox) const
+        {
             Point3 min = Point3(infinity);
             Point3 max = Point3(-infinity);
 
@@ -107,26 +212,27 @@ class RotateY : public Hittable
                         }
                     }
             
-            bbox = AAlignedBBox(min, max);
+            return AAlignedBBox(min, max);
         }
+    
 
-        bool hit(const Ray& ray, Interval rayT, HitRecord& record) const override
+    public:
+        RotateY(shared_ptr<Hittable> obj, float angle) : hittableObject(obj) { setAngle(angle); }
+
+        /// @brief Turn the object, e.g. for the next frame of an animation. Containers above it need a refit().
+        void setAngle(float angle)
         {
-            Point3 origin = Point3
-            (
-                (cosTheta * ray.origin().x()) - (sinTheta * ray.origin().z()),
-                ray.origin().y(),
-                (sinTheta * ray.origin().x()) + (cosTheta * ray.origin().z())
-            );
+            float radians = deg2rad(angle);
 
-            Vector3 direction = Vector3
-            (
-                (cosTheta * ray.direction().x()) - (sinTheta * ray.direction().z()),
-                ray.direction().y(),
-                (sinTheta * ray.direction().x()) + (cosTheta * ray.direction().z())
-            );
+            sinTheta = std::sinf(radians);
+            cosTheta = std::cosf(radians);
+
+            bbox = rotatedBox(hittableObject->boundingBox());
+        }
 
-            Ray rotatedRay = Ray(origin, direction, ray.time());
+        bool hit(const Ray& ray, Interval rayT, HitRecord& record) const override
+        {
+            Ray rotatedRay = rotateRay(ray);
 
             if (!hittableObject->hit(rotatedRay, rayT, record))
                 return false;
@@ -149,7 +255,27 @@ class RotateY : public Hittable
             return true;
         }
 
+        bool occluded(const Ray& ray, Interval rayT) const override
+        {
+            return hittableObject->occluded(rotateRay(ray), rayT);
+        }
+
+        bool entryExitInterval(const Ray& ray, Interval& interval) const override
+        {
+            return hittableObject->entryExitInterval(rotateRay(ray), interval);
+        }
+
         AAlignedBBox boundingBox() const override { return bbox; }
+
+        AAlignedBBox boundingBoxAt(float time) const override { return rotatedBox(hittableObject->boundingBoxAt(time)); }
+
+        bool supportsSpatialSplits() const override { return hittableObject->supportsSpatialSplits(); }
+
+        void refit() override
+        {
+            hittableObject->refit();
+            bbox = rotatedBox(hittableObject->boundingBox());
+        }
 };
 
 
@@ -47,7 +47,43 @@ class HittableList: public Hittable
             return hit;
         }
 
+        bool occluded(const Ray& ray, Interval rayT) const override
+        {
+            for (const shared_ptr<Hittable>& hittableObject : hittableObjects)
+                if (hittableObject->occluded(ray, rayT))
+                    return true;
+
+            return false;
+        }
+
+        void hitPacket(RayPacket& packet, const bool* active, float tMin, float* closest, HitRecord* records, bool* hits) const override
+        {
+            for (const shared_ptr<Hittable>& hittableObject : hittableObjects)
+                hittableObject->hitPacket(packet, active, tMin, closest, records, hits);
+        }
+
         AAlignedBBox boundingBox() const override { return bbox; }
+
+        AAlignedBBox boundingBoxAt(float time) const override
+        {
+            AAlignedBBox timeBox = AAlignedBBox::empty;
+
+            for (const shared_ptr<Hittable>& hittableObject : hittableObjects)
+                timeBox = AAlignedBBox(timeBox, hittableObject->boundingBoxAt(time));
+
+            return timeBox;
+        }
+
+        void refit() override
+        {
+            bbox = AAlignedBBox();
+
+            for (const shared_ptr<Hittable>& hittableObject : hittableObjects)
+            {
+                hittableObject->refit();
+                bbox = AAlignedBBox(bbox, hittableObject->boundingBox());
+            }
+        }
 };
 
 
@@ -8,7 +8,7 @@
 #define STB_IMAGE_IMPLEMENTATION
 #define STBI_FAILURE_USERMSG
 
-#define PATH_TO_IMAGES_FROM_CWD "External\\Images"
+#define PATH_TO_IMAGES_FROM_CWD "External/Images"
 
 #include "../External/stb_image.h"
 #include <cstdlib>
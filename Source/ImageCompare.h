@@ -0,0 +1,469 @@
+#ifndef IMAGECOMPARE_H
+#define IMAGECOMPARE_H
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+// 8-bit RGB image as written by the renderer, with channel values stored in [0, 1].
+class ImageBuffer
+{
+    private:
+        int width = 0;
+        int height = 0;
+        std::vector<Color> pixels;
+
+
+        static bool skipWhitespaceAndComments(std::istream& in)
+        {
+            while (in)
+            {
+                int c = in.peek();
+
+                if (c == '#')
+                    in.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+                else if (std::isspace(c))
+                    in.get();
+                else
+                    break;
+            }
+
+            return bool(in);
+        }
+
+
+    public:
+        ImageBuffer() {}
+        ImageBuffer(int width, int height) : width(width), height(height), pixels(size_t(width) * height) {}
+
+        int imageWidth() const { return width; }
+        int imageHeight() const { return height; }
+        bool isEmpty() const { return pixels.empty(); }
+
+        const Color& at(int x, int y) const { return pixels[size_t(y) * width + x]; }
+        Color& at(int x, int y) { return pixels[size_t(y) * width + x]; }
+
+        /// @brief Read an ASCII (P3) or binary (P6) PPM image with a maximum value of 255.
+        bool readPPM(std::istream& in)
+        {
+            std::string magic;
+            int maxValue = 0;
+
+            in >> magic;
+
+            if (magic != "P3" && magic != "P6")
+                return false;
+
+            if (!skipWhitespaceAndComments(in) || !(in >> width) ||
+                !skipWhitespaceAndComments(in) || !(in >> height) ||
+                !skipWhitespaceAndComments(in) || !(in >> maxValue) ||
+                width <= 0 || height <= 0 || maxValue != 255)
+                return false;
+
+            pixels = std::vector<Color>(size_t(width) * height);
+
+            if (magic == "P6")
+            {
+                in.get();  // The single whitespace character before the raster
+                std::vector<unsigned char> bytes(pixels.size() * 3);
+
+                if (!in.read(reinterpret_cast<char*>(bytes.data()), bytes.size()))
+                    return false;
+
+                for (size_t i = 0; i < pixels.size(); i++)
+                    pixels[i] = Color(bytes[3 * i], bytes[3 * i + 1], bytes[3 * i + 2]) / 255.0f;
+
+                return true;
+            }
+
+            for (Color& pixel : pixels)
+            {
+                int r, g, b;
+
+                if (!(in >> r >> g >> b))
+                    return false;
+
+                pixel = Color(float(r), float(g), float(b)) / 255.0f;
+            }
+
+            return true;
+        }
+
+        bool readPPM(const std::string& filename)
+        {
+            std::ifstream in(filename, std::ios::binary);
+
+            return in && readPPM(in);
+        }
+
+        /// @brief Write the image as a binary (P6) PPM.
+        bool writePPM(const std::string& filename) const
+        {
+            std::ofstream out(filename, std::ios::binary);
+
+            out << "P6\n" << width << " " << height << "\n255\n";
+
+            for (const Color& pixel : pixels)
+                for (int c = 0; c < 3; c++)
+                    out.put(char(std::lround(std::clamp(pixel[c], 0.0f, 1.0f) * 255.0f)));
+
+            return bool(out);
+        }
+};
+
+
+struct ImageDifference
+{
+    float rmse = 0.0f;           // Root mean squared error of the channel values in [0, 1]
+    float psnr = infinity;       // Peak signal-to-noise ratio in dB
+    float meanFlip = 0.0f;       // Mean perceptual error in [0, 1]
+    float maxFlip = 0.0f;
+    float flipPercentile99 = 0.0f;
+};
+
+
+// Perceptual difference of two images in the spirit of FLIP (Andersson et al. 2020): both
+// images are filtered with the contrast sensitivity of the eye at the given viewing distance,
+// compared in a Hunt-adjusted L*a*b* space, and the color error is amplified where edges or
+// points differ. This is a compact approximation for regression testing, not a reference
+// implementation.
+class FlipMetric
+{
+    private:
+        float pixelsPerDegree;
+
+        static float srgbToLinear(float c)
+        {
+            return (c <= 0.04045f) ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+
+        static Vector3 linearRgbToXyz(const Color& c)
+        {
+            return Vector3
+            (
+                0.4124564f * c[0] + 0.3575761f * c[1] + 0.1804375f * c[2],
+                0.2126729f * c[0] + 0.7151522f * c[1] + 0.0721750f * c[2],
+                0.0193339f * c[0] + 0.1191920f * c[1] + 0.9503041f * c[2]
+            );
+        }
+
+        static Color xyzToLinearRgb(const Vector3& v)
+        {
+            return Color
+            (
+                 3.2404542f * v[0] - 1.5371385f * v[1] - 0.4985314f * v[2],
+                -0.9692660f * v[0] + 1.8760108f * v[1] + 0.0415560f * v[2],
+                 0.0556434f * v[0] - 0.2040259f * v[1] + 1.0572252f * v[2]
+            );
+        }
+
+        static Vector3 whitePoint() { return linearRgbToXyz(Color(1.0f)); }
+
+        static Vector3 xyzToYcxcz(const Vector3& v)
+        {
+            Vector3 w = whitePoint();
+            float y = v[1] / w[1];
+
+            return Vector3(116.0f * y - 16.0f, 500.0f * (v[0] / w[0] - y), 200.0f * (y - v[2] / w[2]));
+        }
+
+        static Vector3 ycxczToXyz(const Vector3& v)
+        {
+            Vector3 w = whitePoint();
+            float y = (v[0] + 16.0f) / 116.0f;
+
+            return Vector3((y + v[1] / 500.0f) * w[0], y * w[1], (y - v[2] / 200.0f) * w[2]);
+        }
+
+        static Vector3 xyzToLab(const Vector3& v)
+        {
+            Vector3 w = whitePoint();
+
+            auto f = [](float t)
+            {
+                const float delta = 6.0f / 29.0f;
+                return (t > delta * delta * delta) ? std::cbrt(t) : t / (3.0f * delta * delta) + 4.0f / 29.0f;
+            };
+
+            float fx = f(v[0] / w[0]);
+            float fy = f(v[1] / w[1]);
+            float fz = f(v[2] / w[2]);
+
+            return Vector3(116.0f * fy - 16.0f, 500.0f * (fx - fy), 200.0f * (fy - fz));
+        }
+
+        /// @brief Colorfulness drops at low luminance (Hunt effect).
+        static Vector3 huntAdjust(const Vector3& lab)
+        {
+            float scale = 0.01f * lab[0];
+
+            return Vector3(lab[0], scale * lab[1], scale * lab[2]);
+        }
+
+        static float hyab(const Vector3& a, const Vector3& b)
+        {
+            float da = a[1] - b[1];
+            float db = a[2] - b[2];
+
+            return std::fabs(a[0] - b[0]) + std::sqrt(da * da + db * db);
+        }
+
+        static std::vector<float> gaussianKernel(float sigma)
+        {
+            int radius = std::max(1, int(std::ceil(3.0f * sigma)));
+            std::vector<float> kernel(2 * radius + 1);
+            float sum = 0.0f;
+
+            for (int i = -radius; i <= radius; i++)
+                sum += kernel[i + radius] = std::exp(-0.5f * i * i / (sigma * sigma));
+
+            for (float& k : kernel) k /= sum;
+
+            return kernel;
+        }
+
+        /// @brief Separable convolution with edge clamping.
+        static std::vector<float> convolve
+        (
+            const std::vector<float>& image, int width, int height,
+            const std::vector<float>& kernelX, const std::vector<float>& kernelY
+        )
+        {
+            std::vector<float> horizontal(image.size());
+            std::vector<float> result(image.size());
+            int radiusX = int(kernelX.size()) / 2;
+            int radiusY = int(kernelY.size()) / 2;
+
+            for (int y = 0; y < height; y++)
+                for (int x = 0; x < width; x++)
+                {
+                    float sum = 0.0f;
+
+                    for (int i = -radiusX; i <= radiusX; i++)
+                        sum += kernelX[i + radiusX] * image[size_t(y) * width + std::clamp(x + i, 0, width - 1)];
+
+                    horizontal[size_t(y) * width + x] = sum;
+                }
+
+            for (int y = 0; y < height; y++)
+                for (int x = 0; x < width; x++)
+                {
+                    float sum = 0.0f;
+
+                    for (int i = -radiusY; i <= radiusY; i++)
+                        sum += kernelY[i + radiusY] * horizontal[size_t(std::clamp(y + i, 0, height - 1)) * width + x];
+
+                    result[size_t(y) * width + x] = sum;
+                }
+
+            return result;
+        }
+
+        /// @brief Filter each opponent channel with its contrast sensitivity and convert to Hunt-adjusted L*a*b*.
+        std::vector<Vector3> perceivedColors(const ImageBuffer& image) const
+        {
+            int width = image.imageWidth();
+            int height = image.imageHeight();
+            size_t count = size_t(width) * height;
+
+            std::vector<float> channels[3];
+
+            for (auto& channel : channels)
+                channel.resize(count);
+
+            for (int y = 0; y < height; y++)
+                for (int x = 0; x < width; x++)
+                {
+                    const Color& c = image.at(x, y);
+                    Vector3 ycxcz = xyzToYcxcz(linearRgbToXyz(Color(srgbToLinear(c[0]), srgbToLinear(c[1]), srgbToLinear(c[2]))));
+
+                    for (int i = 0; i < 3; i++)
+                        channels[i][size_t(y) * width + x] = ycxcz[i];
+                }
+
+            // Spatial extent of the contrast sensitivity per channel, in degrees of visual angle.
+            const float sigmaDegrees[3] = { 0.0154f, 0.0164f, 0.0450f };
+
+            for (int i = 0; i < 3; i++)
+            {
+                std::vector<float> kernel = gaussianKernel(std::max(0.3f, sigmaDegrees[i] * pixelsPerDegree));
+                channels[i] = convolve(channels[i], width, height, kernel, kernel);
+            }
+
+            std::vector<Vector3> colors(count);
+
+            for (size_t i = 0; i < count; i++)
+            {
+                Color rgb = xyzToLinearRgb(ycxczToXyz(Vector3(channels[0][i], channels[1][i], channels[2][i])));
+
+                for (int c = 0; c < 3; c++)
+                    rgb[c] = std::clamp(rgb[c], 0.0f, 1.0f);
+
+                colors[i] = huntAdjust(xyzToLab(linearRgbToXyz(rgb)));
+            }
+
+            return colors;
+        }
+
+        /// @brief Edge (first derivative) and point (second derivative) responses of the luminance.
+        void features(const ImageBuffer& image, std::vector<float>& edges, std::vector<float>& points) const
+        {
+            int width = image.imageWidth();
+            int height = image.imageHeight();
+            size_t count = size_t(width) * height;
+
+            std::vector<float> lum(count);
+
+            for (int y = 0; y < height; y++)
+                for (int x = 0; x < width; x++)
+                {
+                    const Color& c = image.at(x, y);
+                    Vector3 xyz = linearRgbToXyz(Color(srgbToLinear(c[0]), srgbToLinear(c[1]), srgbToLinear(c[2])));
+                    lum[size_t(y) * width + x] = (xyzToYcxcz(xyz)[0] + 16.0f) / 116.0f;
+                }
+
+            float sigma = std::max(0.5f, 0.5f * 0.082f * pixelsPerDegree);
+            int radius = int(std::ceil(3.0f * sigma));
+
+            std::vector<float> gauss = gaussianKernel(sigma);
+            std::vector<float> first(gauss.size());
+            std::vector<float> second(gauss.size());
+            float firstPositive = 0.0f;
+            float secondPositive = 0.0f;
+            float secondNegative = 0.0f;
+
+            for (int i = -radius; i <= radius; i++)
+            {
+                float g = gauss[i + radius];
+                first[i + radius] = -i * g;
+                second[i + radius] = (i * i / (sigma * sigma) - 1.0f) * g;
+
+                if (first[i + radius] > 0) firstPositive += first[i + radius];
+                if (second[i + radius] > 0) secondPositive += second[i + radius];
+                else secondNegative -= second[i + radius];
+            }
+
+            // Normalize so positive and negative lobes each sum to one.
+            for (int i = 0; i <= 2 * radius; i++)
+            {
+                first[i] /= firstPositive;
+                second[i] /= (second[i] > 0) ? secondPositive : secondNegative;
+            }
+
+            std::vector<float> edgeX = convolve(lum, width, height, first, gauss);
+            std::vector<float> edgeY = convolve(lum, width, height, gauss, first);
+            std::vector<float> pointX = convolve(lum, width, height, second, gauss);
+            std::vector<float> pointY = convolve(lum, width, height, gauss, second);
+
+            edges.resize(count);
+            points.resize(count);
+
+            for (size_t i = 0; i < count; i++)
+            {
+                edges[i] = std::sqrt(edgeX[i] * edgeX[i] + edgeY[i] * edgeY[i]);
+                points[i] = std::sqrt(pointX[i] * pointX[i] + pointY[i] * pointY[i]);
+            }
+        }
+
+
+    public:
+        /// @param pixelsPerDegree Pixels per degree of visual angle; 67 matches a 0.7 m viewing
+        ///        distance from a 0.7 m wide 4K monitor.
+        FlipMetric(float pixelsPerDegree = 67.0f) : pixelsPerDegree(pixelsPerDegree) {}
+
+        /// @brief Per-pixel perceptual error in [0, 1] between a test image and its reference.
+        std::vector<float> errorMap(const ImageBuffer& test, const ImageBuffer& reference) const
+        {
+            std::vector<Vector3> testColors = perceivedColors(test);
+            std::vector<Vector3> referenceColors = perceivedColors(reference);
+
+            std::vector<float> testEdges, testPoints, referenceEdges, referencePoints;
+            features(test, testEdges, testPoints);
+            features(reference, referenceEdges, referencePoints);
+
+            // The largest color difference, between pure green and pure blue, maps to an error of 1.
+            const float exponent = 0.7f;
+            const float breakpointColor = 0.4f;
+            const float breakpointError = 0.95f;
+            float maxColorDifference = std::pow(hyab
+            (
+                huntAdjust(xyzToLab(linearRgbToXyz(Color(0, 1, 0)))),
+                huntAdjust(xyzToLab(linearRgbToXyz(Color(0, 0, 1))))
+            ), exponent);
+
+            std::vector<float> errors(testColors.size());
+
+            for (size_t i = 0; i < errors.size(); i++)
+            {
+                float colorDifference = std::pow(hyab(testColors[i], referenceColors[i]), exponent);
+                float colorError;
+
+                if (colorDifference < breakpointColor * maxColorDifference)
+                    colorError = breakpointError / (breakpointColor * maxColorDifference) * colorDifference;
+                else
+                    colorError = breakpointError + (colorDifference - breakpointColor * maxColorDifference)
+                               / (maxColorDifference - breakpointColor * maxColorDifference) * (1.0f - breakpointError);
+
+                float featureDifference = std::max
+                (
+                    std::fabs(testEdges[i] - referenceEdges[i]),
+                    std::fabs(testPoints[i] - referencePoints[i])
+                );
+                float featureError = std::pow(std::min(1.0f, featureDifference / std::sqrt(2.0f)), 0.5f);
+
+                errors[i] = std::pow(std::min(1.0f, colorError), 1.0f - featureError);
+            }
+
+            return errors;
+        }
+};
+
+
+/// @brief Compare a test image with a reference of the same size.
+inline ImageDifference compareImages(const ImageBuffer& test, const ImageBuffer& reference, float pixelsPerDegree = 67.0f)
+{
+    ImageDifference difference;
+
+    double squaredErrorSum = 0.0;
+
+    for (int y = 0; y < test.imageHeight(); y++)
+        for (int x = 0; x < test.imageWidth(); x++)
+            for (int c = 0; c < 3; c++)
+            {
+                double d = test.at(x, y)[c] - reference.at(x, y)[c];
+                squaredErrorSum += d * d;
+            }
+
+    size_t pixelCount = size_t(test.imageWidth()) * test.imageHeight();
+
+    difference.rmse = float(std::sqrt(squaredErrorSum / std::max<size_t>(1, 3 * pixelCount)));
+    difference.psnr = (difference.rmse > 0.0f) ? -20.0f * std::log10(difference.rmse) : infinity;
+
+    std::vector<float> errors = FlipMetric(pixelsPerDegree).errorMap(test, reference);
+
+    if (errors.empty())
+        return difference;
+
+    double errorSum = 0.0;
+
+    for (float e : errors)
+        errorSum += e;
+
+    difference.meanFlip = float(errorSum / errors.size());
+    difference.maxFlip = *std::max_element(errors.begin(), errors.end());
+
+    std::nth_element(errors.begin(), errors.begin() + (errors.size() * 99) / 100, errors.end());
+    difference.flipPercentile99 = errors[(errors.size() * 99) / 100];
+
+    return difference;
+}
+
+
+#endif
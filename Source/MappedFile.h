@@ -0,0 +1,132 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#ifdef _WIN32
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include <cstddef>
+#include <string>
+
+
+// Read-only memory map of a whole file, so binary data can be used in place without reading or
+// parsing it. Owns the mapping and cannot be copied.
+class MappedFile
+{
+    private:
+#ifdef _WIN32
+        HANDLE file = INVALID_HANDLE_VALUE;
+        HANDLE mapping = nullptr;
+#else
+        int file = -1;
+#endif
+        const unsigned char* bytes = nullptr;
+        size_t byteCount = 0;
+
+
+    public:
+        MappedFile() {}
+        explicit MappedFile(const std::string& filename) { open(filename); }
+        ~MappedFile() { close(); }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        /// @return false if the file does not exist, is empty or cannot be mapped.
+        bool open(const std::string& filename)
+        {
+            close();
+
+#ifdef _WIN32
+            file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+            if (file == INVALID_HANDLE_VALUE)
+                return false;
+
+            LARGE_INTEGER fileSize;
+
+            if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+            {
+                close();
+                return false;
+            }
+
+            mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+
+            if (!view)
+            {
+                close();
+                return false;
+            }
+
+            bytes = static_cast<const unsigned char*>(view);
+            byteCount = size_t(fileSize.QuadPart);
+#else
+            file = ::open(filename.c_str(), O_RDONLY);
+
+            if (file < 0)
+                return false;
+
+            struct stat status;
+
+            if (fstat(file, &status) != 0 || status.st_size == 0)
+            {
+                close();
+                return false;
+            }
+
+            void* view = mmap(nullptr, size_t(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+
+            if (view == MAP_FAILED)
+            {
+                close();
+                return false;
+            }
+
+            bytes = static_cast<const unsigned char*>(view);
+            byteCount = size_t(status.st_size);
+#endif
+
+            return true;
+        }
+
+        void close()
+        {
+#ifdef _WIN32
+            if (bytes) UnmapViewOfFile(bytes);
+            if (mapping) CloseHandle(mapping);
+            if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+
+            mapping = nullptr;
+            file = INVALID_HANDLE_VALUE;
+#else
+            if (bytes) munmap(const_cast<unsigned char*>(bytes), byteCount);
+            if (file >= 0) ::close(file);
+
+            file = -1;
+#endif
+
+            bytes = nullptr;
+            byteCount = 0;
+        }
+
+        bool isOpen() const { return bytes != nullptr; }
+        const unsigned char* data() const { return bytes; }
+        size_t size() const { return byteCount; }
+};
+
+
+#endif
@@ -2,6 +2,7 @@
 #define MATERIAL_H
 
 #include "Hittable.h"
+#include "Sampler.h"
 #include "Texture.h"
 
 class Material
@@ -14,7 +15,8 @@ class Material
             const Ray& ray,
             const HitRecord& record,
             Color& attenuation,
-            Ray& scattered
+            Ray& scattered,
+            Sampler& sampler
         ) const
         {
             return false;
@@ -37,12 +39,9 @@ class LambertianMaterial : public Material
         LambertianMaterial(const Color& albedo) : tex(make_shared<SolidColorTexture>(albedo)) {}
         LambertianMaterial(shared_ptr<Texture> texture) : tex(texture) {}
 
-        bool scatter(const Ray& ray, const HitRecord& record, Color& attenuation, Ray& scattered) const override
+        bool scatter(const Ray& ray, const HitRecord& record, Color& attenuation, Ray& scattered, Sampler& sampler) const override
         {
-            Vector3 scatterDirection = record.normal + randomUnitVector();
-
-            if (scatterDirection.nearZero())
-                scatterDirection = record.normal;
+            Vector3 scatterDirection = sampleCosineHemisphere(record.normal, sampler.get2D());
 
             scattered = Ray(record.p, scatterDirection, ray.time());
             attenuation = tex->value(record.u, record.v, record.p);
@@ -62,10 +61,10 @@ class MetalMaterial : public Material
         MetalMaterial(const Color& albedo, float fuzz) : fuzz(fuzz), tex(make_shared<SolidColorTexture>(albedo)) {}
         MetalMaterial(shared_ptr<Texture> texture, float fuzz) : tex(texture), fuzz(fuzz) {}
 
-        bool scatter(const Ray& ray, const HitRecord& record, Color& attenuation, Ray& scattered) const override
+        bool scatter(const Ray& ray, const HitRecord& record, Color& attenuation, Ray& scattered, Sampler& sampler) const override
         {
             Vector3 reflected = reflect(ray.direction(), record.normal);
-            reflected = normalized(reflected) + (fuzz * randomUnitVector());
+            reflected = normalized(reflected) + (fuzz * sampleUniformSphere(sampler.get2D()));
             
             scattered = Ray(record.p, reflected, ray.time());
             attenuation = tex->value(record.u, record.v, record.p);
@@ -94,7 +93,7 @@ class DielectricMaterial : public Material
         DielectricMaterial(float refractionIndex) : refractionIndex(refractionIndex), tint(Color(1)) {}
         DielectricMaterial(float refractionIndex, Color tint) : refractionIndex(refractionIndex), tint(tint) {}
 
-        bool scatter(const Ray& ray, const HitRecord& record, Color& attenuation, Ray& scattered) const override
+        bool scatter(const Ray& ray, const HitRecord& record, Color& attenuation, Ray& scattered, Sampler& sampler) const override
         {
             attenuation = tint;
             
@@ -108,7 +107,7 @@ class DielectricMaterial : public Material
 
             Vector3 direction;
 
-            if (cannotRefract || reflectance(cosTheta, ri) > randomFloat())
+            if (cannotRefract || reflectance(cosTheta, ri) > sampler.get1D())
                 direction = reflect(unitDirection, record.normal);
             else
                 direction = refract(unitDirection, -record.normal, ri);
@@ -147,9 +146,9 @@ class Isotropic : public Material
         Isotropic(const Color& albedo) : tex(make_shared<SolidColorTexture>(albedo)) {}
         Isotropic(shared_ptr<Texture> texture) : tex(texture) {}
 
-        bool scatter(const Ray& ray, const HitRecord& record, Color& attenuation, Ray& scattered) const override
+        bool scatter(const Ray& ray, const HitRecord& record, Color& attenuation, Ray& scattered, Sampler& sampler) const override
         {
-            scattered = Ray(record.p, randomUnitVector(), ray.time());
+            scattered = Ray(record.p, sampleUniformSphere(sampler.get2D()), ray.time());
             attenuation = tex->value(record.u, record.v, record.p);
 
             return true;
@@ -0,0 +1,275 @@
+#ifndef NETWORK_H
+#define NETWORK_H
+
+#ifdef _WIN32
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+
+    #ifdef _MSC_VER
+        #pragma comment(lib, "Ws2_32.lib")
+    #endif
+#else
+    #include <netdb.h>
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    #include <sys/select.h>
+    #include <sys/socket.h>
+    #include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+
+
+// Minimal blocking TCP socket over Winsock / POSIX sockets. Owns its handle and is move-only.
+class Socket
+{
+    private:
+#ifdef _WIN32
+        using Handle = SOCKET;
+        static constexpr Handle invalidHandle = INVALID_SOCKET;
+#else
+        using Handle = int;
+        static constexpr Handle invalidHandle = -1;
+#endif
+
+        Handle handle = invalidHandle;
+
+
+        explicit Socket(Handle handle) : handle(handle) {}
+
+        /// @brief Winsock has to be started once per process before any socket call.
+        static bool startNetworking()
+        {
+#ifdef _WIN32
+            static bool started = []()
+            {
+                WSADATA data;
+                return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+            }();
+
+            return started;
+#else
+            return true;
+#endif
+        }
+
+        static void closeHandle(Handle handle)
+        {
+#ifdef _WIN32
+            closesocket(handle);
+#else
+            ::close(handle);
+#endif
+        }
+
+        void disableNagle()
+        {
+            int enable = 1;
+            setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&enable), sizeof(enable));
+        }
+
+
+    public:
+        Socket() = default;
+        Socket(const Socket&) = delete;
+        Socket& operator=(const Socket&) = delete;
+
+        Socket(Socket&& other) noexcept : handle(std::exchange(other.handle, invalidHandle)) {}
+
+        Socket& operator=(Socket&& other) noexcept
+        {
+            if (this != &other)
+            {
+                close();
+                handle = std::exchange(other.handle, invalidHandle);
+            }
+
+            return *this;
+        }
+
+        ~Socket() { close(); }
+
+
+        bool isValid() const { return handle != invalidHandle; }
+
+        void close()
+        {
+            if (isValid())
+                closeHandle(handle);
+
+            handle = invalidHandle;
+        }
+
+        /// @brief Make receives give up once nothing arrived for timeoutMilliseconds; 0 waits forever.
+        bool setReceiveTimeout(int timeoutMilliseconds) const
+        {
+#ifdef _WIN32
+            DWORD timeout = DWORD(timeoutMilliseconds);
+#else
+            timeval timeout;
+            timeout.tv_sec = timeoutMilliseconds / 1000;
+            timeout.tv_usec = (timeoutMilliseconds % 1000) * 1000;
+#endif
+
+            return setsockopt(handle, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout)) == 0;
+        }
+
+        /// @brief End both directions of the connection without closing the handle, so a receive
+        ///        blocked on another thread returns.
+        void shutdown() const
+        {
+            if (!isValid()) return;
+#ifdef _WIN32
+            ::shutdown(handle, SD_BOTH);
+#else
+            ::shutdown(handle, SHUT_RDWR);
+#endif
+        }
+
+        /// @brief Open a socket accepting connections on the given port of every interface.
+        /// @return An invalid socket if the port can not be bound.
+        static Socket listen(uint16_t port, int backlog = 64)
+        {
+            if (!startNetworking()) return Socket();
+
+            Socket server(::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP));
+
+            if (!server.isValid()) return Socket();
+
+            int reuse = 1;
+            setsockopt(server.handle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+            sockaddr_in address;
+            std::memset(&address, 0, sizeof(address));
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_ANY);
+            address.sin_port = htons(port);
+
+            if (::bind(server.handle, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+                ::listen(server.handle, backlog) != 0)
+                return Socket();
+
+            return server;
+        }
+
+        /// @brief Connect to host:port, trying every address the host name resolves to.
+        /// @return An invalid socket if no connection could be made.
+        static Socket connect(const std::string& host, uint16_t port)
+        {
+            if (!startNetworking()) return Socket();
+
+            addrinfo hints;
+            std::memset(&hints, 0, sizeof(hints));
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            hints.ai_protocol = IPPROTO_TCP;
+
+            addrinfo* addresses = nullptr;
+
+            if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0)
+                return Socket();
+
+            Socket client;
+
+            for (addrinfo* a = addresses; a != nullptr; a = a->ai_next)
+            {
+                Socket candidate(::socket(a->ai_family, a->ai_socktype, a->ai_protocol));
+
+                if (candidate.isValid() && ::connect(candidate.handle, a->ai_addr, int(a->ai_addrlen)) == 0)
+                {
+                    client = std::move(candidate);
+                    client.disableNagle();
+                    break;
+                }
+            }
+
+            freeaddrinfo(addresses);
+
+            return client;
+        }
+
+        /// @brief Wait up to timeoutMilliseconds for a pending connection and accept it.
+        /// @return An invalid socket on timeout or error.
+        Socket accept(int timeoutMilliseconds) const
+        {
+            fd_set readable;
+            FD_ZERO(&readable);
+            FD_SET(handle, &readable);
+
+            timeval timeout;
+            timeout.tv_sec = timeoutMilliseconds / 1000;
+            timeout.tv_usec = (timeoutMilliseconds % 1000) * 1000;
+
+            if (::select(int(handle) + 1, &readable, nullptr, nullptr, &timeout) <= 0)
+                return Socket();
+
+            Socket client(::accept(handle, nullptr, nullptr));
+
+            if (client.isValid())
+                client.disableNagle();
+
+            return client;
+        }
+
+        /// @brief Send all bytes, blocking until done.
+        bool sendAll(const void* data, size_t size) const
+        {
+            const char* bytes = static_cast<const char*>(data);
+
+            while (size > 0)
+            {
+                int chunk = int(std::min<size_t>(size, 1 << 20));
+#ifdef _WIN32
+                int sent = ::send(handle, bytes, chunk, 0);
+#else
+                int sent = int(::send(handle, bytes, chunk, MSG_NOSIGNAL));
+#endif
+                if (sent <= 0) return false;
+
+                bytes += sent;
+                size -= sent;
+            }
+
+            return true;
+        }
+
+        /// @brief Receive exactly size bytes, blocking until done.
+        /// @return False if the connection was closed or broke first, or a receive timed out.
+        bool receiveAll(void* data, size_t size) const
+        {
+            char* bytes = static_cast<char*>(data);
+
+            while (size > 0)
+            {
+                int chunk = int(std::min<size_t>(size, 1 << 20));
+                int received = int(::recv(handle, bytes, chunk, 0));
+
+                if (received <= 0) return false;
+
+                bytes += received;
+                size -= received;
+            }
+
+            return true;
+        }
+
+        template <typename T>
+        bool sendValue(const T& value) const { return sendAll(&value, sizeof(T)); }
+
+        template <typename T>
+        bool receiveValue(T& value) const { return receiveAll(&value, sizeof(T)); }
+};
+
+
+#endif
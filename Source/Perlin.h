@@ -54,14 +54,23 @@ class Perlin
 
     
     public:
-        Perlin()
+        /// @brief The noise is drawn from a stream of its own, selected by sequence, so it does not depend
+        ///        on how many random numbers were drawn before it (e.g. by a BVH builder) and drawing it
+        ///        leaves the stream of the caller untouched.
+        Perlin(uint64_t sequence = 0)
         {
+            RandomGenerator generator;
+            generator.seed(sequence);
+            std::swap(threadRandomGenerator, generator);
+
             for (int i = 0; i < pointCount; i++)
                 randomVectors[i] = normalized(Vector3::randomVector(-1, 1));
             
             perlinGeneratePerm(permX);
             perlinGeneratePerm(permY);
             perlinGeneratePerm(permZ);
+
+            std::swap(threadRandomGenerator, generator);
         }
 
 
@@ -5,149 +5,202 @@
 #include "HittableList.h"
 
 
-class Quad : public Hittable
+// Plane of a parallelogram or triangle spanned by the edges u and v from Q, in edge-plane form
+// (48 bytes). A point P of the plane has the coordinates
+//     alpha = dotP(alphaPlane, P) - alphaOffset,   beta = dotP(betaPlane, P) - betaOffset
+// along u and v, so a test costs two dot products instead of two cross products.
+struct EdgePlanes
 {
-    private:
-    Point3  Q;
-    Vector3 u;
-    Vector3 v;
-    Vector3 w;
     Vector3 normal;
     float   d;
-    shared_ptr<Material>    mat;
-    AAlignedBBox            bbox;
+    Vector3 alphaPlane;
+    float   alphaOffset;
+    Vector3 betaPlane;
+    float   betaOffset;
 
 
-public:
-    Quad(const Point3& Q, const Vector3& u, const Vector3& v, shared_ptr<Material> mat)
-    : Q(Q), u(u), v(v), mat(mat)
+    EdgePlanes(const Point3& Q, const Vector3& u, const Vector3& v)
     {
         Vector3 n = crossP(u, v);
+        Vector3 w = n / dotP(n, n);
+
         normal = normalized(n);
         d = dotP(normal, Q);
-        w = n / dotP(n, n);
-
-        setBoundingBox();
-    }
 
-    virtual void setBoundingBox()
-    {
-        AAlignedBBox bboxDiagonal1 = AAlignedBBox(Q, Q + u + v);
-        AAlignedBBox bboxDiagonal2 = AAlignedBBox(Q + u, Q + v);
-        bbox = AAlignedBBox(bboxDiagonal1, bboxDiagonal2);
+        // dotP(w, crossP(P - Q, v)) = dotP(P - Q, crossP(v, w)), and likewise for beta
+        alphaPlane = crossP(v, w);
+        alphaOffset = dotP(alphaPlane, Q);
+        betaPlane = crossP(w, u);
+        betaOffset = dotP(betaPlane, Q);
     }
 
-    AAlignedBBox boundingBox() const override { return bbox; }
-
-    bool hit(const Ray& ray, Interval rayT, HitRecord& record) const override
+    /// @brief Intersect the ray with the plane within rayT.
+    /// @return false if the ray is parallel to the plane or meets it outside rayT.
+    bool intersect(const Ray& ray, const Interval& rayT, float& t, Point3& p, float& alpha, float& beta) const
     {
         float denominator = dotP(normal, ray.direction());
 
         if (std::fabs(denominator) < 1e-9) return false;
 
-        float t = (d - dotP(normal, ray.origin())) / denominator;
+        t = (d - dotP(normal, ray.origin())) / denominator;
 
         if (!rayT.contains(t)) return false;
 
-        Point3 planeIntersection = ray.at(t);
-        Vector3 planarHitpointVector = planeIntersection - Q;
-        float alpha = dotP(w, crossP(planarHitpointVector, v));
-        float beta = dotP(w, crossP(u, planarHitpointVector));
+        p = ray.at(t);
+        alpha = dotP(alphaPlane, p) - alphaOffset;
+        beta = dotP(betaPlane, p) - betaOffset;
 
-        if (!interiorHit(alpha, beta, record)) return false;
+        return true;
+    }
 
-        record.t = t;
-        record.p = planeIntersection;
-        record.mat = mat;
-        record.setFaceNormal(ray, normal);
+    /// @brief The point of the plane with coordinates (alpha, beta), i.e. Q + alpha * u + beta * v.
+    Point3 point(float alpha, float beta) const
+    {
+        // Cramer's rule for the three planes through the point
+        Vector3 alphaBeta = crossP(alphaPlane, betaPlane);
+        Vector3 betaNormal = crossP(betaPlane, normal);
+        Vector3 normalAlpha = crossP(normal, alphaPlane);
 
-        return true;
+        return (d * alphaBeta + (alphaOffset + alpha) * betaNormal + (betaOffset + beta) * normalAlpha) / dotP(normal, alphaBeta);
     }
 
-    virtual bool interiorHit(float a, float b, HitRecord& record) const
+    /// @brief Bounding box of the given points of the plane, padded for the rounding of point().
+    AAlignedBBox boundingBox(std::initializer_list<Vector3> coordinates) const
     {
-        Interval unitInterval = Interval(0, 1);
+        Point3 min = Point3(infinity);
+        Point3 max = Point3(-infinity);
+
+        for (const Vector3& coordinate : coordinates)
+        {
+            Point3 corner = point(coordinate.x(), coordinate.y());
+
+            for (int axis = 0; axis < 3; axis++)
+            {
+                min[axis] = std::fmin(min[axis], corner[axis]);
+                max[axis] = std::fmax(max[axis], corner[axis]);
+            }
+        }
 
-        if (!unitInterval.contains(a) || !unitInterval.contains(b)) return false;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float padding = 1e-5f * std::fmax(std::fabs(min[axis]), std::fabs(max[axis]));
 
-        record.u = a;
-        record.v = b;
+            min[axis] -= padding;
+            max[axis] += padding;
+        }
 
-        return true;
+        return AAlignedBBox(min, max);
     }
 };
 
+static_assert(sizeof(EdgePlanes) == 48, "EdgePlanes should stay 48 bytes");
 
-class Triangle : public Hittable
+
+// Parallelogram from Q spanned by u and v. Only the edge planes and the material are stored;
+// the bounding box is derived on demand, since the BVH keeps its own copy.
+class Quad : public Hittable
 {
     private:
-        Point3  Q;
-        Vector3 u;
-        Vector3 v;
-        Vector3 w;
-        Vector3 normal;
-        float   d;
-        shared_ptr<Material>    mat;
-        AAlignedBBox            bbox;
+        EdgePlanes planes;
+        shared_ptr<Material> mat;
 
 
     public:
-        Triangle(const Point3& Q, const Vector3& u, const Vector3& v, shared_ptr<Material> mat)
-        : Q(Q), u(u), v(v), mat(mat)
+        Quad(const Point3& Q, const Vector3& u, const Vector3& v, shared_ptr<Material> mat)
+        : planes(Q, u, v), mat(mat) {}
+
+        AAlignedBBox boundingBox() const override
+        {
+            return planes.boundingBox({ Vector3(0, 0, 0), Vector3(1, 0, 0), Vector3(0, 1, 0), Vector3(1, 1, 0) });
+        }
+
+        bool supportsSpatialSplits() const override { return true; }
+
+        bool hit(const Ray& ray, Interval rayT, HitRecord& record) const override
         {
-            Vector3 n = crossP(u, v);
-            normal = normalized(n);
-            d = dotP(normal, Q);
-            w = n / dotP(n, n);
+            float t;
+            Point3 p;
+            float alpha;
+            float beta;
+
+            if (!planes.intersect(ray, rayT, t, p, alpha, beta)) return false;
+
+            if (alpha < 0.0f || alpha > 1.0f || beta < 0.0f || beta > 1.0f) return false;
+
+            record.t = t;
+            record.p = p;
+            record.u = alpha;
+            record.v = beta;
+            record.mat = mat;
+            record.setFaceNormal(ray, planes.normal);
 
-            setBoundingBox();
+            return true;
         }
 
-        virtual void setBoundingBox()
+        bool occluded(const Ray& ray, Interval rayT) const override
         {
-            AAlignedBBox bboxU = AAlignedBBox(Q, Q + u);
-            AAlignedBBox bboxV = AAlignedBBox(Q, Q + v);
+            float t;
+            Point3 p;
+            float alpha;
+            float beta;
 
-            bbox = AAlignedBBox(bboxU, bboxV);
+            if (!planes.intersect(ray, rayT, t, p, alpha, beta)) return false;
+
+            return alpha >= 0.0f && alpha <= 1.0f && beta >= 0.0f && beta <= 1.0f;
         }
+};
 
-        AAlignedBBox boundingBox() const override { return bbox; }
 
-        bool hit(const Ray& ray, Interval rayT, HitRecord& record) const override
-        {
-            float denominator = dotP(normal, ray.direction());
+// Triangle Q, Q + u, Q + v, stored like Quad.
+class Triangle : public Hittable
+{
+    private:
+        EdgePlanes planes;
+        shared_ptr<Material> mat;
 
-            if (std::fabs(denominator) < 1e-9) return false;
 
-            float t = (d - dotP(normal, ray.origin())) / denominator;
+    public:
+        Triangle(const Point3& Q, const Vector3& u, const Vector3& v, shared_ptr<Material> mat)
+        : planes(Q, u, v), mat(mat) {}
+
+        AAlignedBBox boundingBox() const override
+        {
+            return planes.boundingBox({ Vector3(0, 0, 0), Vector3(1, 0, 0), Vector3(0, 1, 0) });
+        }
 
-            if (!rayT.contains(t)) return false;
+        bool supportsSpatialSplits() const override { return true; }
 
-            Point3 planeIntersection = ray.at(t);
-            Vector3 planarHitpointVector = planeIntersection - Q;
-            float alpha = dotP(w, crossP(planarHitpointVector, v));
-            float beta = dotP(w, crossP(u, planarHitpointVector));
+        bool hit(const Ray& ray, Interval rayT, HitRecord& record) const override
+        {
+            float t;
+            Point3 p;
+            float alpha;
+            float beta;
+
+            if (!planes.intersect(ray, rayT, t, p, alpha, beta)) return false;
 
-            if (!interiorHit(alpha, beta, record)) return false;
+            if (alpha < 0.0f || beta < 0.0f || alpha + beta > 1.0f) return false;
 
             record.t = t;
-            record.p = planeIntersection;
+            record.p = p;
+            record.u = alpha;
+            record.v = beta;
             record.mat = mat;
-            record.setFaceNormal(ray, normal);
+            record.setFaceNormal(ray, planes.normal);
 
             return true;
         }
 
-        virtual bool interiorHit(float a, float b, HitRecord& record) const
+        bool occluded(const Ray& ray, Interval rayT) const override
         {
-            Interval unitInterval = Interval(0, 1);
-
-            if (a < 0 || b < 0 || !unitInterval.contains(a + b)) return false;
+            float t;
+            Point3 p;
+            float alpha;
+            float beta;
 
-            record.u = a;
-            record.v = b;
+            if (!planes.intersect(ray, rayT, t, p, alpha, beta)) return false;
 
-            return true;
+            return alpha >= 0.0f && beta >= 0.0f && alpha + beta <= 1.0f;
         }
 };
 
@@ -185,6 +238,13 @@ class Sphere : public Hittable
             bbox = AAlignedBBox(bbox1, bbox2);
         }
 
+        AAlignedBBox boundingBoxAt(float time) const override
+        {
+            Point3 currentCenter = center.at(time);
+
+            return AAlignedBBox(currentCenter - Vector3(radius), currentCenter + Vector3(radius));
+        }
+
         bool hit(const Ray& ray, Interval rayT, HitRecord& record) const override
         {
             Point3 currentCenter = center.at(ray.time());
@@ -222,13 +282,543 @@ class Sphere : public Hittable
             return true;
         }
 
+        bool occluded(const Ray& ray, Interval rayT) const override
+        {
+            Vector3 oc = center.at(ray.time()) - ray.origin();
+
+            float a = dotP(ray.direction(), ray.direction());
+            float h = dotP(ray.direction(), oc);
+            float c = dotP(oc, oc) - radius * radius;
+
+            float discriminant = h * h - a * c;
+
+            if (discriminant < 0)
+                return false;
+
+            discriminant = std::sqrt(discriminant);
+
+            return rayT.surrounds((h - discriminant) / a) || rayT.surrounds((h + discriminant) / a);
+        }
+
+        bool entryExitInterval(const Ray& ray, Interval& interval) const override
+        {
+            Vector3 oc = center.at(ray.time()) - ray.origin();
+
+            float a = dotP(ray.direction(), ray.direction());
+            float h = dotP(ray.direction(), oc);
+            float c = dotP(oc, oc) - radius * radius;
+
+            float discriminant = h * h - a * c;
+
+            if (discriminant <= 0)
+                return false;
+
+            discriminant = std::sqrt(discriminant);
+            interval = Interval((h - discriminant) / a, (h + discriminant) / a);
+
+            return true;
+        }
+
+        AAlignedBBox boundingBox() const override { return bbox; }
+
+        bool supportsSpatialSplits() const override { return center.direction().magnitude() == 0.0f; }
+};
+
+
+/// @brief Angle of a vector around an axis, mapped to [0, 1]; tangent and bitangent span the plane normal to the axis.
+inline float azimuthU(const Vector3& radial, const Vector3& tangent, const Vector3& bitangent)
+{
+    return (std::atan2(dotP(radial, bitangent), dotP(radial, tangent)) + pi) / (2 * pi);
+}
+
+
+// Flat, round disk facing along normal. One plane solve per ray.
+class Disk : public Hittable
+{
+    private:
+        Point3  center;
+        Vector3 normal;
+        Vector3 tangent;
+        Vector3 bitangent;
+        float   radius;
+        shared_ptr<Material> mat;
+        AAlignedBBox bbox;
+
+        bool intersect(const Ray& ray, Interval rayT, float& t) const
+        {
+            float denominator = dotP(normal, ray.direction());
+
+            if (std::fabs(denominator) < 1e-9) return false;
+
+            t = dotP(normal, center - ray.origin()) / denominator;
+
+            if (!rayT.contains(t)) return false;
+
+            Vector3 offset = ray.at(t) - center;
+
+            return dotP(offset, offset) <= radius * radius;
+        }
+
+
+    public:
+        Disk(const Point3& center, const Vector3& normal, float radius, shared_ptr<Material> mat)
+        : center(center), normal(normalized(normal)), radius(radius), mat(mat)
+        {
+            orthonormalBasis(this->normal, tangent, bitangent);
+
+            // A disk reaches radius * sin(angle between normal and axis) along each axis.
+            Vector3 extent;
+
+            for (int axis = 0; axis < 3; axis++)
+                extent[axis] = radius * std::sqrt(std::fmax(0.0f, 1.0f - this->normal[axis] * this->normal[axis]));
+
+            bbox = AAlignedBBox(center - extent, center + extent);
+        }
+
+        bool hit(const Ray& ray, Interval rayT, HitRecord& record) const override
+        {
+            float t;
+
+            if (!intersect(ray, rayT, t)) return false;
+
+            record.t = t;
+            record.p = ray.at(t);
+
+            Vector3 offset = record.p - center;
+            record.u = azimuthU(offset, tangent, bitangent);
+            record.v = offset.magnitude() / radius;
+            record.mat = mat;
+            record.setFaceNormal(ray, normal);
+
+            return true;
+        }
+
+        bool occluded(const Ray& ray, Interval rayT) const override
+        {
+            float t;
+
+            return intersect(ray, rayT, t);
+        }
+
+        AAlignedBBox boundingBox() const override { return bbox; }
+
+        bool supportsSpatialSplits() const override { return true; }
+};
+
+
+// Cylinder of a radius around the segment from base to base + height * axis, closed by two disks
+// unless capped is false. The side is one quadratic solve, each cap one plane solve.
+class Cylinder : public Hittable
+{
+    private:
+        enum class Surface { Side, Bottom, Top };
+
+        Point3  base;
+        Vector3 axis;
+        Vector3 tangent;
+        Vector3 bitangent;
+        float   radius;
+        float   height;
+        bool    capped;
+        shared_ptr<Material> mat;
+        AAlignedBBox bbox;
+
+        bool intersect(const Ray& ray, Interval rayT, float& t, Surface& surface) const
+        {
+            Vector3 oc = ray.origin() - base;
+            float axialOrigin = dotP(oc, axis);
+            float axialDirection = dotP(ray.direction(), axis);
+            Vector3 radialOrigin = oc - axialOrigin * axis;
+            Vector3 radialDirection = ray.direction() - axialDirection * axis;
+
+            bool found = false;
+            t = rayT.max;
+
+            // Side: |radialOrigin + t * radialDirection| = radius
+            float a = dotP(radialDirection, radialDirection);
+            float h = dotP(radialDirection, radialOrigin);
+            float c = dotP(radialOrigin, radialOrigin) - radius * radius;
+            float discriminant = h * h - a * c;
+
+            if (a > 0 && discriminant >= 0)
+            {
+                discriminant = std::sqrt(discriminant);
+
+                for (float root : { (-h - discriminant) / a, (-h + discriminant) / a })
+                {
+                    float y = axialOrigin + root * axialDirection;
+
+                    if (Interval(rayT.min, t).surrounds(root) && 0.0f <= y && y <= height)
+                    {
+                        t = root;
+                        surface = Surface::Side;
+                        found = true;
+                        break;
+                    }
+                }
+            }
+
+            if (!capped || axialDirection == 0.0f)
+                return found;
+
+            for (Surface cap : { Surface::Bottom, Surface::Top })
+            {
+                float root = ((cap == Surface::Top ? height : 0.0f) - axialOrigin) / axialDirection;
+                Vector3 radial = radialOrigin + root * radialDirection;
+
+                if (Interval(rayT.min, t).surrounds(root) && dotP(radial, radial) <= radius * radius)
+                {
+                    t = root;
+                    surface = cap;
+                    found = true;
+                }
+            }
+
+            return found;
+        }
+
+
+    public:
+        Cylinder(const Point3& base, const Vector3& axis, float radius, float height, shared_ptr<Material> mat, bool capped = true)
+        : base(base), axis(normalized(axis)), radius(radius), height(height), capped(capped), mat(mat)
+        {
+            orthonormalBasis(this->axis, tangent, bitangent);
+
+            AAlignedBBox bottom = Disk(base, this->axis, radius, mat).boundingBox();
+            AAlignedBBox top = Disk(base + height * this->axis, this->axis, radius, mat).boundingBox();
+
+            bbox = AAlignedBBox(bottom, top);
+        }
+
+        bool hit(const Ray& ray, Interval rayT, HitRecord& record) const override
+        {
+            float t;
+            Surface surface;
+
+            if (!intersect(ray, rayT, t, surface)) return false;
+
+            record.t = t;
+            record.p = ray.at(t);
+
+            Vector3 offset = record.p - base;
+            float y = dotP(offset, axis);
+            Vector3 radial = offset - y * axis;
+
+            record.u = azimuthU(radial, tangent, bitangent);
+
+            if (surface == Surface::Side)
+            {
+                record.v = y / height;
+                record.setFaceNormal(ray, radial / radius);
+            }
+            else
+            {
+                record.v = radial.magnitude() / radius;
+                record.setFaceNormal(ray, (surface == Surface::Top) ? axis : -axis);
+            }
+
+            record.mat = mat;
+
+            return true;
+        }
+
+        bool occluded(const Ray& ray, Interval rayT) const override
+        {
+            float t;
+            Surface surface;
+
+            return intersect(ray, rayT, t, surface);
+        }
+
+        AAlignedBBox boundingBox() const override { return bbox; }
+
+        bool supportsSpatialSplits() const override { return true; }
+};
+
+
+// Cone with a round base of a radius at base and its apex at base + height * axis, closed by a
+// disk at the base unless capped is false. The side is one quadratic solve, the base one plane solve.
+class Cone : public Hittable
+{
+    private:
+        enum class Surface { Side, Base };
+
+        Point3  base;
+        Vector3 axis;
+        Vector3 tangent;
+        Vector3 bitangent;
+        float   radius;
+        float   height;
+        float   slope;      // radius / height
+        bool    capped;
+        shared_ptr<Material> mat;
+        AAlignedBBox bbox;
+
+        bool intersect(const Ray& ray, Interval rayT, float& t, Surface& surface) const
+        {
+            Vector3 oc = ray.origin() - base;
+            float axialOrigin = dotP(oc, axis);
+            float axialDirection = dotP(ray.direction(), axis);
+            Vector3 radialOrigin = oc - axialOrigin * axis;
+            Vector3 radialDirection = ray.direction() - axialDirection * axis;
+
+            bool found = false;
+            t = rayT.max;
+
+            // Side: |radialOrigin + t * radialDirection| = slope * (height - axialOrigin - t * axialDirection)
+            float slopeSquared = slope * slope;
+            float toApex = height - axialOrigin;
+
+            float a = dotP(radialDirection, radialDirection) - slopeSquared * axialDirection * axialDirection;
+            float h = dotP(radialDirection, radialOrigin) + slopeSquared * toApex * axialDirection;
+            float c = dotP(radialOrigin, radialOrigin) - slopeSquared * toApex * toApex;
+
+            float roots[2];
+            int rootCount = 0;
+
+            if (std::fabs(a) < 1e-9f)
+            {
+                // Ray parallel to the side: the equation is linear
+                if (h != 0.0f)
+                    roots[rootCount++] = -c / (2.0f * h);
+            }
+            else
+            {
+                float discriminant = h * h - a * c;
+
+                if (discriminant >= 0)
+                {
+                    discriminant = std::sqrt(discriminant);
+                    roots[0] = (-h - discriminant) / a;
+                    roots[1] = (-h + discriminant) / a;
+                    rootCount = 2;
+
+                    if (roots[0] > roots[1]) std::swap(roots[0], roots[1]);
+                }
+            }
+
+            // The equation also describes the mirrored cone beyond the apex; only 0 <= y <= height is kept.
+            for (int i = 0; i < rootCount; i++)
+            {
+                float y = axialOrigin + roots[i] * axialDirection;
+
+                if (Interval(rayT.min, t).surrounds(roots[i]) && 0.0f <= y && y <= height)
+                {
+                    t = roots[i];
+                    surface = Surface::Side;
+                    found = true;
+                    break;
+                }
+            }
+
+            if (!capped || axialDirection == 0.0f)
+                return found;
+
+            float root = -axialOrigin / axialDirection;
+            Vector3 radial = radialOrigin + root * radialDirection;
+
+            if (Interval(rayT.min, t).surrounds(root) && dotP(radial, radial) <= radius * radius)
+            {
+                t = root;
+                surface = Surface::Base;
+                found = true;
+            }
+
+            return found;
+        }
+
+
+    public:
+        Cone(const Point3& base, const Vector3& axis, float radius, float height, shared_ptr<Material> mat, bool capped = true)
+        : base(base), axis(normalized(axis)), radius(radius), height(height), slope(radius / height), capped(capped), mat(mat)
+        {
+            orthonormalBasis(this->axis, tangent, bitangent);
+
+            AAlignedBBox baseBox = Disk(base, this->axis, radius, mat).boundingBox();
+            Point3 apex = base + height * this->axis;
+
+            bbox = AAlignedBBox(baseBox, AAlignedBBox(apex, apex));
+        }
+
+        bool hit(const Ray& ray, Interval rayT, HitRecord& record) const override
+        {
+            float t;
+            Surface surface;
+
+            if (!intersect(ray, rayT, t, surface)) return false;
+
+            record.t = t;
+            record.p = ray.at(t);
+
+            Vector3 offset = record.p - base;
+            float y = dotP(offset, axis);
+            Vector3 radial = offset - y * axis;
+            float radialLength = radial.magnitude();
+
+            record.u = azimuthU(radial, tangent, bitangent);
+
+            if (surface == Surface::Side)
+            {
+                // The side leans inwards by the slope; at the apex the normal points along the axis.
+                Vector3 outward = (radialLength > 0.0f) ? radial / radialLength + slope * axis : axis;
+
+                record.v = y / height;
+                record.setFaceNormal(ray, normalized(outward));
+            }
+            else
+            {
+                record.v = radialLength / radius;
+                record.setFaceNormal(ray, -axis);
+            }
+
+            record.mat = mat;
+
+            return true;
+        }
+
+        bool occluded(const Ray& ray, Interval rayT) const override
+        {
+            float t;
+            Surface surface;
+
+            return intersect(ray, rayT, t, surface);
+        }
+
+        AAlignedBBox boundingBox() const override { return bbox; }
+
+        bool supportsSpatialSplits() const override { return true; }
+};
+
+
+// Axis-aligned box, intersected with a single slab test. The hit face lies on the axis whose slab
+// the ray enters last (or leaves first, when it starts inside); that axis gives the normal and UVs.
+class AxisBox : public Hittable
+{
+    private:
+        AAlignedBBox bbox;
+        shared_ptr<Material> mat;
+
+        /// @brief Intersect the whole line of the ray with the box.
+        /// @param nearAxis Axis of the face where the line enters, at tNear.
+        /// @param farAxis Axis of the face where the line leaves, at tFar.
+        bool slabs(const Ray& ray, float& tNear, float& tFar, int& nearAxis, int& farAxis) const
+        {
+            tNear = -infinity;
+            tFar = infinity;
+            nearAxis = 0;
+            farAxis = 0;
+
+            for (int axis = 0; axis < 3; axis++)
+            {
+                const Interval& slab = bbox.axisInterval(axis);
+                float adinv = 1.0f / ray.direction()[axis];
+
+                float t0 = (slab.min - ray.origin()[axis]) * adinv;
+                float t1 = (slab.max - ray.origin()[axis]) * adinv;
+
+                if (t0 > t1) std::swap(t0, t1);
+
+                if (t0 > tNear)
+                {
+                    tNear = t0;
+                    nearAxis = axis;
+                }
+
+                if (t1 < tFar)
+                {
+                    tFar = t1;
+                    farAxis = axis;
+                }
+            }
+
+            return tNear <= tFar;
+        }
+
+
+    public:
+        AxisBox(const Point3& corner1, const Point3& corner2, shared_ptr<Material> mat)
+        : bbox(corner1, corner2), mat(mat) {}
+
+        bool hit(const Ray& ray, Interval rayT, HitRecord& record) const override
+        {
+            float tNear;
+            float tFar;
+            int nearAxis;
+            int farAxis;
+
+            if (!slabs(ray, tNear, tFar, nearAxis, farAxis)) return false;
+
+            bool entering = rayT.contains(tNear);
+
+            if (!entering && !rayT.contains(tFar)) return false;
+
+            int axis = entering ? nearAxis : farAxis;
+            float direction = ray.direction()[axis];
+
+            record.t = entering ? tNear : tFar;
+            record.p = ray.at(record.t);
+
+            // The face entered through faces against the ray, the face left through along it.
+            Vector3 outwardNormal = Vector3(0);
+            outwardNormal[axis] = ((direction > 0.0f) != entering) ? 1.0f : -1.0f;
+            record.setFaceNormal(ray, outwardNormal);
+
+            const Interval& uAxis = bbox.axisInterval((axis + 1) % 3);
+            const Interval& vAxis = bbox.axisInterval((axis + 2) % 3);
+            record.u = (record.p[(axis + 1) % 3] - uAxis.min) / uAxis.size();
+            record.v = (record.p[(axis + 2) % 3] - vAxis.min) / vAxis.size();
+            record.mat = mat;
+
+            return true;
+        }
+
+        bool occluded(const Ray& ray, Interval rayT) const override
+        {
+            float tNear;
+            float tFar;
+            int nearAxis;
+            int farAxis;
+
+            return slabs(ray, tNear, tFar, nearAxis, farAxis) && (rayT.contains(tNear) || rayT.contains(tFar));
+        }
+
+        bool entryExitInterval(const Ray& ray, Interval& interval) const override
+        {
+            float tNear;
+            float tFar;
+            int nearAxis;
+            int farAxis;
+
+            if (!slabs(ray, tNear, tFar, nearAxis, farAxis) || tNear == tFar) return false;
+
+            interval = Interval(tNear, tFar);
+
+            return true;
+        }
+
         AAlignedBBox boundingBox() const override { return bbox; }
+
+        bool supportsSpatialSplits() const override { return true; }
 };
 
 
 // COMPOSITES
 // Cube
-inline shared_ptr<HittableList> Cube(const Point3& center, float sideLength, shared_ptr<Material> mat)
+inline shared_ptr<AxisBox> Cube(const Point3& center, float sideLength, shared_ptr<Material> mat)
+{
+    Vector3 halfDiagonal = Vector3(0.5f * sideLength);
+
+    return make_shared<AxisBox>(center - halfDiagonal, center + halfDiagonal, mat);
+}
+
+// Box
+inline shared_ptr<AxisBox> Box(const Point3& boxCorner1, const Point3& boxCorner2, shared_ptr<Material> mat)
+{
+    return make_shared<AxisBox>(boxCorner1, boxCorner2, mat);
+}
+
+// Cube made of six quads
+inline shared_ptr<HittableList> QuadCube(const Point3& center, float sideLength, shared_ptr<Material> mat)
 {
     auto faces = make_shared<HittableList>();
 
@@ -259,8 +849,8 @@ inline shared_ptr<HittableList> Cube(const Point3& center, float sideLength, sha
     return faces;
 }
         
-// Box
-inline shared_ptr<HittableList> Box(const Point3& boxCorner1, const Point3& boxCorner2, shared_ptr<Material> mat)
+// Box made of six quads
+inline shared_ptr<HittableList> QuadBox(const Point3& boxCorner1, const Point3& boxCorner2, shared_ptr<Material> mat)
 {
     auto faces = make_shared<HittableList>();
 
@@ -336,13 +926,13 @@ inline shared_ptr<HittableList> Hexagon(const Point3& baseCenter, float r, share
     return NGon(6, baseCenter, r, mat);
 }
 
-// Disk (2D flat on y-Plane)
-inline shared_ptr<HittableList> Disk(const Point3& baseCenter, float r, shared_ptr<Material> mat)
+// Disk (2D flat on y-Plane) as a 100-gon; the Disk class is the exact, much cheaper shape.
+inline shared_ptr<HittableList> TessellatedDisk(const Point3& baseCenter, float r, shared_ptr<Material> mat)
 {
     return NGon(100, baseCenter, r, mat);
 }
 
-// N-Prism
+// N-Prism (a tessellated cylinder for large n; see the Cylinder class for the exact shape)
 inline shared_ptr<HittableList> NPrism(int n, const Point3& C, float r, float h, shared_ptr<Material> mat)
 {
     auto faces = make_shared<HittableList>();
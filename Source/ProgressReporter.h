@@ -0,0 +1,154 @@
+#ifndef PROGRESSREPORTER_H
+#define PROGRESSREPORTER_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+
+// Rays traced by the current thread; a plain thread-local count, so tracing never touches shared memory.
+inline thread_local uint64_t threadRayCount = 0;
+
+
+// Collects render progress from worker threads through relaxed atomic counters and prints it
+// from its own thread a few times per second, so workers never wait on logging.
+class ProgressReporter
+{
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        std::atomic<uint64_t> completedWork = 0;
+        std::atomic<uint64_t> tracedRays = 0;
+        // Identifies the reporter to the threads that publish rays to it; unlike its address, never reused.
+        uint64_t    id;
+        std::thread::id creatorThread;
+        uint64_t    creatorStartRays;
+        uint64_t    totalWork;
+        std::string unit;
+        std::chrono::duration<float> interval;
+        Clock::time_point startTime;
+
+        std::thread reporter;
+        std::mutex  stopMutex;
+        std::condition_variable stopRequested;
+        bool        stopping = false;
+
+
+        static void writeTime(std::ostream& out, float seconds)
+        {
+            int totalSeconds = static_cast<int>(seconds);
+
+            out << std::setw(2) << std::setfill('0') << totalSeconds / 60 << ":"
+                << std::setw(2) << std::setfill('0') << totalSeconds % 60;
+        }
+
+        void report() const
+        {
+            float elapsed = std::chrono::duration<float>(Clock::now() - startTime).count();
+            uint64_t done = completedWork.load(std::memory_order_relaxed);
+            uint64_t rays = tracedRays.load(std::memory_order_relaxed);
+
+            std::clog << "\rProcessing... "
+                      << std::fixed << std::setprecision(2) << 100.0 * done / std::max<uint64_t>(1, totalWork) << "% "
+                      << "(" << done << " / " << totalWork << " " << unit << ") ";
+            writeTime(std::clog, elapsed);
+            std::clog << " elapsed";
+
+            if (done > 0)
+            {
+                std::clog << ", ";
+                writeTime(std::clog, elapsed * (totalWork - std::min(done, totalWork)) / done);
+                std::clog << " left";
+            }
+
+            std::clog << ". " << std::setprecision(2) << rays / std::max(1e-3f, elapsed) * 1e-6f << " Mrays/s       " << std::flush;
+        }
+
+        void reportLoop()
+        {
+            std::unique_lock<std::mutex> lock(stopMutex);
+
+            while (!stopRequested.wait_for(lock, interval, [&]() { return stopping; }))
+                report();
+        }
+
+
+    public:
+        /// @param totalWork Amount of work in the whole render, in the given unit (e.g. rows).
+        /// @param enabled Without it nothing is printed and no reporter thread is started.
+        ProgressReporter(uint64_t totalWork, const std::string& unit, bool enabled, float intervalSeconds = 0.5f)
+        : totalWork(totalWork), unit(unit), interval(intervalSeconds), startTime(Clock::now())
+        {
+            static std::atomic<uint64_t> nextID = 0;
+
+            id = nextID.fetch_add(1, std::memory_order_relaxed);
+            creatorThread = std::this_thread::get_id();
+            creatorStartRays = threadRayCount;
+
+            if (enabled)
+                reporter = std::thread(&ProgressReporter::reportLoop, this);
+        }
+
+        ~ProgressReporter() { stop(); }
+
+        ProgressReporter(const ProgressReporter&) = delete;
+        ProgressReporter& operator=(const ProgressReporter&) = delete;
+
+        /// @brief Record finished work together with the rays the calling thread traced for this reporter
+        ///        since its last call. On its first call, rays are counted from when the reporter was
+        ///        created for the thread that created it, and from zero for others, which are expected
+        ///        to be render threads started after it.
+        void add(uint64_t work)
+        {
+            struct PublishedRays
+            {
+                uint64_t reporterID = UINT64_MAX;
+                uint64_t count = 0;
+            };
+
+            static thread_local PublishedRays published;
+
+            if (published.reporterID != id)
+            {
+                published.reporterID = id;
+                published.count = (std::this_thread::get_id() == creatorThread) ? creatorStartRays : 0;
+            }
+
+            completedWork.fetch_add(work, std::memory_order_relaxed);
+            tracedRays.fetch_add(threadRayCount - published.count, std::memory_order_relaxed);
+            published.count = threadRayCount;
+        }
+
+        /// @brief Stop reporting and print the total render time and ray throughput.
+        void stop()
+        {
+            if (!reporter.joinable())
+                return;
+
+            {
+                std::lock_guard<std::mutex> lock(stopMutex);
+                stopping = true;
+            }
+
+            stopRequested.notify_all();
+            reporter.join();
+
+            float elapsed = std::chrono::duration<float>(Clock::now() - startTime).count();
+
+            std::clog << "\rDone. Render time: ";
+            writeTime(std::clog, elapsed);
+            std::clog << ". " << std::fixed << std::setprecision(2)
+                      << tracedRays.load(std::memory_order_relaxed) / std::max(1e-3f, elapsed) * 1e-6f
+                      << " Mrays/s.                                        ";
+        }
+};
+
+
+#endif
@@ -0,0 +1,187 @@
+#ifndef RAYPACKET_H
+#define RAYPACKET_H
+
+#include "AAlignedBBox.h"
+
+#include <algorithm>
+
+
+constexpr int maxPacketSize = 64;  // 8 x 8 pixels
+
+
+// Coherent rays (e.g. the primary rays of neighbouring pixels) traced through the scene together.
+// Ray data is also kept per component (structure of arrays), so the per-ray loops in the box tests
+// compile to SIMD code. Every ray carries the random stream it was generated with; primitives that
+// consume random numbers while intersecting (volumes) are called with that stream active, so a ray
+// gives exactly the same result as when traced on its own.
+class RayPacket
+{
+    private:
+        // Conservative bounds over all rays, for culling whole packets (interval arithmetic)
+        Interval originBounds[3];
+        Interval inverseDirectionBounds[3];
+        bool     hasCommonSign[3];
+
+        static Interval multiply(const Interval& a, const Interval& b)
+        {
+            float p0 = a.min * b.min;
+            float p1 = a.min * b.max;
+            float p2 = a.max * b.min;
+            float p3 = a.max * b.max;
+
+            return Interval(std::min({ p0, p1, p2, p3 }), std::max({ p0, p1, p2, p3 }));
+        }
+
+
+    public:
+        int size = 0;
+        Ray rays[maxPacketSize];
+        RandomGenerator generators[maxPacketSize];
+
+        float originX[maxPacketSize];
+        float originY[maxPacketSize];
+        float originZ[maxPacketSize];
+        float inverseDirectionX[maxPacketSize];
+        float inverseDirectionY[maxPacketSize];
+        float inverseDirectionZ[maxPacketSize];
+
+
+        void clear() { size = 0; }
+
+        /// @brief Add a ray together with the state of the random stream it continues with.
+        void add(const Ray& ray, const RandomGenerator& generator)
+        {
+            rays[size] = ray;
+            generators[size] = generator;
+            size++;
+        }
+
+        /// @brief Fill the per-component arrays and packet bounds; call after the last add().
+        void finalize()
+        {
+            for (int axis = 0; axis < 3; axis++)
+            {
+                originBounds[axis] = Interval::empty;
+                inverseDirectionBounds[axis] = Interval::empty;
+            }
+
+            for (int i = 0; i < size; i++)
+            {
+                const Point3& origin = rays[i].origin();
+                const Vector3& direction = rays[i].direction();
+
+                originX[i] = origin.x();
+                originY[i] = origin.y();
+                originZ[i] = origin.z();
+                inverseDirectionX[i] = 1.0f / direction.x();
+                inverseDirectionY[i] = 1.0f / direction.y();
+                inverseDirectionZ[i] = 1.0f / direction.z();
+
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    float inverse = 1.0f / direction[axis];
+
+                    originBounds[axis] = Interval(originBounds[axis], Interval(origin[axis], origin[axis]));
+                    inverseDirectionBounds[axis] = Interval(inverseDirectionBounds[axis], Interval(inverse, inverse));
+                }
+            }
+
+            for (int axis = 0; axis < 3; axis++)
+            {
+                const Interval& inverse = inverseDirectionBounds[axis];
+
+                hasCommonSign[axis] = std::isfinite(inverse.min) && std::isfinite(inverse.max) &&
+                                      (inverse.min > 0.0f || inverse.max < 0.0f);
+            }
+        }
+
+        /// @brief Conservative test whether every ray of the packet misses the box within [tMin, tMax].
+        ///        Axes along which the rays point in different directions are not used for culling.
+        bool missesAll(const AAlignedBBox& bbox, float tMin, float tMax) const
+        {
+            float entry = tMin;
+            float exit = tMax;
+
+            for (int axis = 0; axis < 3; axis++)
+            {
+                if (!hasCommonSign[axis])
+                    continue;
+
+                const Interval& slab = bbox.axisInterval(axis);
+                const Interval& origin = originBounds[axis];
+
+                Interval toMin = multiply(Interval(slab.min - origin.max, slab.min - origin.min), inverseDirectionBounds[axis]);
+                Interval toMax = multiply(Interval(slab.max - origin.max, slab.max - origin.min), inverseDirectionBounds[axis]);
+
+                bool positive = inverseDirectionBounds[axis].min > 0.0f;
+                const Interval& near = positive ? toMin : toMax;
+                const Interval& far = positive ? toMax : toMin;
+
+                entry = std::max(entry, near.min);
+                exit = std::min(exit, far.max);
+            }
+
+            // Leave a margin, so rounding never culls a ray that the exact per-ray test would hit.
+            return exit < entry - 1e-4f * (1.0f + std::fabs(entry));
+        }
+
+        /// @brief Per-ray slab test with the same arithmetic as AAlignedBBox::hit().
+        /// @return Whether any active ray hits the box; hits[i] is set for each of them.
+        bool hitBox(const AAlignedBBox& bbox, const bool* active, float tMin, const float* tMax, bool* hits) const
+        {
+            const float* origins[3] = { originX, originY, originZ };
+            const float* inverseDirections[3] = { inverseDirectionX, inverseDirectionY, inverseDirectionZ };
+
+            // Only the span of rays from the first to the last active one is tested.
+            int first = 0;
+            int last = size;
+
+            while (first < last && !active[first]) first++;
+            while (last > first && !active[last - 1]) last--;
+
+            if (first == last)
+                return false;
+
+            float rayTMin[maxPacketSize];
+            float rayTMax[maxPacketSize];
+
+            for (int i = first; i < last; i++)
+            {
+                rayTMin[i] = tMin;
+                rayTMax[i] = tMax[i];
+            }
+
+            for (int axis = 0; axis < 3; axis++)
+            {
+                const Interval& slab = bbox.axisInterval(axis);
+                const float* origin = origins[axis];
+                const float* inverseDirection = inverseDirections[axis];
+
+                for (int i = first; i < last; i++)
+                {
+                    float t0 = (slab.min - origin[i]) * inverseDirection[i];
+                    float t1 = (slab.max - origin[i]) * inverseDirection[i];
+
+                    bool ordered = t0 < t1;
+                    float near = ordered ? t0 : t1;
+                    float far = ordered ? t1 : t0;
+
+                    rayTMin[i] = (near > rayTMin[i]) ? near : rayTMin[i];
+                    rayTMax[i] = (far < rayTMax[i]) ? far : rayTMax[i];
+                }
+            }
+
+            bool anyHit = false;
+
+            for (int i = 0; i < size; i++)
+            {
+                hits[i] = first <= i && i < last && active[i] && rayTMax[i] > rayTMin[i];
+                anyHit |= hits[i];
+            }
+
+            return anyHit;
+        }
+};
+
+
+#endif
@@ -0,0 +1,382 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
+
+enum class SamplerType
+{
+    Independent,
+    Stratified,
+    Halton,
+    Sobol
+};
+
+
+// Sample generation helpers
+
+/// @brief Element i of a pseudo-random permutation of [0, length), selected by permutationSeed (Kensler).
+inline uint32_t permutationElement(uint32_t i, uint32_t length, uint32_t permutationSeed)
+{
+    uint32_t w = length - 1;
+    w |= w >> 1;
+    w |= w >> 2;
+    w |= w >> 4;
+    w |= w >> 8;
+    w |= w >> 16;
+
+    do
+    {
+        i ^= permutationSeed;
+        i *= 0xe170893d;
+        i ^= permutationSeed >> 16;
+        i ^= (i & w) >> 4;
+        i ^= permutationSeed >> 8;
+        i *= 0x0929eb3f;
+        i ^= permutationSeed >> 23;
+        i ^= (i & w) >> 1;
+        i *= 1 | permutationSeed >> 27;
+        i *= 0x6935fa69;
+        i ^= (i & w) >> 11;
+        i *= 0x74dcb303;
+        i ^= (i & w) >> 2;
+        i *= 0x9e501cc3;
+        i ^= (i & w) >> 2;
+        i *= 0xc860a3df;
+        i &= w;
+        i ^= i >> 5;
+    } while (i >= length);
+
+    return (i + permutationSeed) % length;
+}
+
+inline uint32_t reverseBits32(uint32_t n)
+{
+    n = (n << 16) | (n >> 16);
+    n = ((n & 0x00ff00ff) << 8) | ((n & 0xff00ff00) >> 8);
+    n = ((n & 0x0f0f0f0f) << 4) | ((n & 0xf0f0f0f0) >> 4);
+    n = ((n & 0x33333333) << 2) | ((n & 0xcccccccc) >> 2);
+    n = ((n & 0x55555555) << 1) | ((n & 0xaaaaaaaa) >> 1);
+
+    return n;
+}
+
+/// @brief Owen scrambling of a base-2 fixed point value: every bit is flipped depending on
+///        the bits above it (hash-based nested uniform scramble, Laine-Karras / Burley).
+inline uint32_t owenScramble(uint32_t v, uint32_t seed)
+{
+    v = reverseBits32(v);
+    v += seed;
+    v ^= v * 0x6c50b47cu;
+    v ^= v * 0xb82f1e52u;
+    v ^= v * 0xc7afe638u;
+    v ^= v * 0x8d22f6e6u;
+
+    return reverseBits32(v);
+}
+
+/// @brief The first two dimensions of the Sobol sequence as 32-bit fixed point values.
+inline void sobol2D(uint32_t index, uint32_t& x, uint32_t& y)
+{
+    x = reverseBits32(index);
+    y = 0;
+
+    for (uint32_t v = 1u << 31; index != 0; index >>= 1, v ^= v >> 1)
+        if (index & 1) y ^= v;
+}
+
+/// @brief Radical inverse of index in the given base with Owen-scrambled digits.
+inline float owenScrambledRadicalInverse(int base, uint64_t index, uint64_t seed)
+{
+    float invBase = 1.0f / base;
+    float invBaseM = 1.0f;
+    uint64_t reversedDigits = 0;
+    int digitIndex = 0;
+
+    // Keep going past the last non-zero digit so trailing zeros are scrambled too,
+    // until the digits drop below float precision.
+    while (1.0f - (base - 1) * invBaseM < 1.0f)
+    {
+        uint64_t next = index / base;
+        int digit = int(index - next * base);
+
+        uint32_t digitSeed = uint32_t(mixBits(hashCombine(seed, reversedDigits) ^ uint64_t(digitIndex)));
+        digit = int(permutationElement(uint32_t(digit), uint32_t(base), digitSeed));
+
+        reversedDigits = reversedDigits * base + digit;
+        invBaseM *= invBase;
+        index = next;
+        digitIndex++;
+    }
+
+    return std::fmin(float(reversedDigits * double(invBaseM)), oneMinusEpsilon);
+}
+
+inline float fixedPointToFloat(uint32_t v) { return std::fmin(v * 0x1p-32f, oneMinusEpsilon); }
+
+
+// Source of sample values for the Monte Carlo integrator. Values are requested in
+// dimensions: every get1D() / get2D() call of one camera sample uses the next dimension,
+// so samplers can distribute each dimension well over the samples of a pixel.
+class Sampler
+{
+    protected:
+        int dimension = 0;
+
+
+    public:
+        virtual ~Sampler() = default;
+
+        /// @brief Begin a new camera sample; resets the dimension counter.
+        virtual void startPixelSample(int /*x*/, int /*y*/, int /*sampleIndex*/) {}
+
+        /// @return The dimension the next get1D() / get2D() call will use.
+        int currentDimension() const { return dimension; }
+
+        /// @brief Continue a camera sample at the given dimension. Together with startPixelSample(), this
+        ///        lets one sampler serve many paths that are traced in turns.
+        void setDimension(int nextDimension) { dimension = nextDimension; }
+
+        /// @return Sample value in [0, 1).
+        virtual float get1D() = 0;
+
+        /// @return Sample point in [0, 1)^2, stored in x and y.
+        virtual Vector3 get2D() = 0;
+};
+
+
+// Uniform random values without any correlation between samples. Each value is a hash of
+// (seed, pixel, sample index, dimension), so it does not depend on what was drawn before.
+class IndependentSampler : public Sampler
+{
+    private:
+        uint64_t seed;
+        uint64_t sampleHash = 0;
+
+        float next() { return hashToFloat(hashCombine(sampleHash, uint64_t(dimension++))); }
+
+
+    public:
+        IndependentSampler(uint64_t seed = 0) : seed(seed) {}
+
+        void startPixelSample(int x, int y, int sampleIndex) override
+        {
+            sampleHash = hashCombine(hashCombine(hashCombine(seed, uint64_t(x)), uint64_t(y)), uint64_t(sampleIndex));
+            dimension = 0;
+        }
+
+        float get1D() override { return next(); }
+
+        Vector3 get2D() override
+        {
+            float x = next();
+            float y = next();
+
+            return Vector3(x, y, 0);
+        }
+};
+
+
+// Jittered stratification: the samples of a pixel cover a grid of strata, visited in a
+// different random order per pixel and dimension so dimensions stay uncorrelated.
+class StratifiedSampler : public Sampler
+{
+    private:
+        int xStrata;
+        int yStrata;
+        uint64_t seed;
+        uint64_t pixelHash = 0;
+        int sampleIndex = 0;
+
+        uint32_t stratum(int strataCount, uint64_t dimensionHash) const
+        {
+            return permutationElement(uint32_t(sampleIndex % strataCount), strataCount, uint32_t(dimensionHash));
+        }
+
+        /// @brief Jitter inside a stratum, computed from the sample and dimension alone.
+        float jitter(uint64_t dimensionHash, uint64_t component) const
+        {
+            return hashToFloat(hashCombine(hashCombine(dimensionHash, uint64_t(sampleIndex)), component));
+        }
+
+
+    public:
+        /// @param samplesPerPixel Number of samples per pixel; the strata grid is sized to cover them.
+        StratifiedSampler(int samplesPerPixel, uint64_t seed = 0) : seed(seed)
+        {
+            xStrata = std::max(1, int(std::sqrt(float(samplesPerPixel))));
+            yStrata = (std::max(1, samplesPerPixel) + xStrata - 1) / xStrata;
+        }
+
+        void startPixelSample(int x, int y, int sampleIndex) override
+        {
+            pixelHash = hashCombine(hashCombine(seed, uint64_t(x)), uint64_t(y));
+            this->sampleIndex = sampleIndex;
+            dimension = 0;
+        }
+
+        float get1D() override
+        {
+            int strataCount = xStrata * yStrata;
+            uint64_t dimensionHash = hashCombine(pixelHash, uint64_t(dimension++));
+
+            return std::fmin((stratum(strataCount, dimensionHash) + jitter(dimensionHash, 0)) / strataCount, oneMinusEpsilon);
+        }
+
+        Vector3 get2D() override
+        {
+            uint64_t dimensionHash = hashCombine(pixelHash, uint64_t(dimension++));
+            uint32_t s = stratum(xStrata * yStrata, dimensionHash);
+
+            float x = std::fmin(((s % xStrata) + jitter(dimensionHash, 0)) / xStrata, oneMinusEpsilon);
+            float y = std::fmin(((s / xStrata) + jitter(dimensionHash, 1)) / yStrata, oneMinusEpsilon);
+
+            return Vector3(x, y, 0);
+        }
+};
+
+
+// Scrambled Halton points. Dimension d uses the radical inverse in the d-th prime base with
+// Owen-scrambled digits; the scramble is seeded by pixel and dimension so neighbouring pixels
+// do not share the same pattern. Dimensions past the prime table reuse the bases with a
+// shuffled sample order to keep them decorrelated.
+class HaltonSampler : public Sampler
+{
+    private:
+        static constexpr int primeCount = 16;
+        static constexpr int primes[primeCount] = { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53 };
+
+        uint32_t shuffleLength;
+        uint64_t seed;
+        uint64_t pixelHash = 0;
+        int sampleIndex = 0;
+
+        float sampleDimension()
+        {
+            uint64_t dimensionHash = hashCombine(pixelHash, uint64_t(dimension));
+            uint32_t index = uint32_t(sampleIndex);
+
+            if (dimension >= primeCount)
+            {
+                uint32_t block = index & ~(shuffleLength - 1);
+                index = block | permutationElement(index & (shuffleLength - 1), shuffleLength, uint32_t(dimensionHash));
+            }
+
+            int base = primes[dimension % primeCount];
+            dimension++;
+
+            return owenScrambledRadicalInverse(base, index, dimensionHash);
+        }
+
+
+    public:
+        HaltonSampler(int samplesPerPixel, uint64_t seed = 0) : seed(seed)
+        {
+            shuffleLength = 1;
+
+            while (shuffleLength < uint32_t(std::max(1, samplesPerPixel)))
+                shuffleLength <<= 1;
+        }
+
+        void startPixelSample(int x, int y, int sampleIndex) override
+        {
+            pixelHash = hashCombine(hashCombine(seed, uint64_t(x)), uint64_t(y));
+            this->sampleIndex = sampleIndex;
+            dimension = 0;
+        }
+
+        float get1D() override { return sampleDimension(); }
+
+        Vector3 get2D() override
+        {
+            float x = sampleDimension();
+            float y = sampleDimension();
+
+            return Vector3(x, y, 0);
+        }
+};
+
+
+// Padded Owen-scrambled Sobol points. Every 1D/2D request takes the first one or two Sobol
+// dimensions with its own scramble and its own shuffle of the sample order, both seeded by
+// pixel and dimension. Best with power-of-two sample counts.
+class SobolSampler : public Sampler
+{
+    private:
+        uint32_t shuffleLength;
+        uint64_t seed;
+        uint64_t pixelHash = 0;
+        int sampleIndex = 0;
+
+        // Shuffle the samples within each block of shuffleLength so dimensions are decorrelated.
+        uint32_t shuffledIndex(uint64_t dimensionHash) const
+        {
+            uint32_t block = uint32_t(sampleIndex) & ~(shuffleLength - 1);
+            uint32_t offset = uint32_t(sampleIndex) & (shuffleLength - 1);
+
+            return block | permutationElement(offset, shuffleLength, uint32_t(dimensionHash));
+        }
+
+
+    public:
+        SobolSampler(int samplesPerPixel, uint64_t seed = 0) : seed(seed)
+        {
+            shuffleLength = 1;
+
+            while (shuffleLength < uint32_t(std::max(1, samplesPerPixel)))
+                shuffleLength <<= 1;
+        }
+
+        void startPixelSample(int x, int y, int sampleIndex) override
+        {
+            pixelHash = hashCombine(hashCombine(seed, uint64_t(x)), uint64_t(y));
+            this->sampleIndex = sampleIndex;
+            dimension = 0;
+        }
+
+        float get1D() override
+        {
+            uint64_t dimensionHash = hashCombine(pixelHash, uint64_t(dimension));
+            dimension++;
+
+            uint32_t x = reverseBits32(shuffledIndex(dimensionHash));
+
+            return fixedPointToFloat(owenScramble(x, uint32_t(dimensionHash >> 32)));
+        }
+
+        Vector3 get2D() override
+        {
+            uint64_t dimensionHash = hashCombine(pixelHash, uint64_t(dimension));
+            dimension++;
+
+            uint32_t x;
+            uint32_t y;
+            sobol2D(shuffledIndex(dimensionHash), x, y);
+
+            uint32_t scrambleSeed = uint32_t(dimensionHash >> 32);
+            uint32_t scrambleSeedY = uint32_t(mixBits(dimensionHash));
+
+            return Vector3(fixedPointToFloat(owenScramble(x, scrambleSeed)), fixedPointToFloat(owenScramble(y, scrambleSeedY)), 0);
+        }
+};
+
+
+inline std::unique_ptr<Sampler> makeSampler(SamplerType type, int samplesPerPixel, uint64_t seed = 0)
+{
+    switch (type)
+    {
+        case SamplerType::Stratified:
+            return std::make_unique<StratifiedSampler>(samplesPerPixel, seed);
+        case SamplerType::Halton:
+            return std::make_unique<HaltonSampler>(samplesPerPixel, seed);
+        case SamplerType::Sobol:
+            return std::make_unique<SobolSampler>(samplesPerPixel, seed);
+        default:
+            return std::make_unique<IndependentSampler>(seed);
+    }
+}
+
+
+#endif
@@ -3,6 +3,7 @@
 
 #include "Image.h"
 #include "Perlin.h"
+#include "VoxelGrid.h"
 
 
 class Texture
@@ -89,14 +90,83 @@ class NoiseTexture : public Texture
         Perlin noise;
         float scale;
         float turbulence;
+        VoxelGrid bakedTurbulence;
 
 
     public:
-        NoiseTexture(float scale, float turbulence) : scale(scale), turbulence(turbulence) {}
+        // Error of a baked turbulence grid, measured against the procedural turbulence.
+        struct BakeStatistics
+        {
+            float meanAbsoluteError = 0.0f;
+            float rmsError = 0.0f;
+            float maxAbsoluteError = 0.0f;
+            size_t memoryBytes = 0;
+        };
+
+        /// @param sequence Selects the noise; textures in one scene that should not repeat each other's
+        ///        pattern need different sequences.
+        NoiseTexture(float scale, float turbulence, uint64_t sequence = 0)
+        : noise(sequence), scale(scale), turbulence(turbulence) {}
+
+        /// @brief Precompute the turbulence inside a region on a grid, sampled trilinearly at render time.
+        ///        Points outside the region keep using the procedural noise.
+        /// @param region The bounds of the region to bake.
+        /// @param resolution Number of grid points per axis.
+        /// @param errorSamples Number of random points used to measure the baking error.
+        /// @return Error statistics of the baked grid compared to the procedural turbulence.
+        BakeStatistics bake(const AAlignedBBox& region, int resolution, int errorSamples = 10000)
+        {
+            bakedTurbulence = VoxelGrid(region, resolution);
+            bakedTurbulence.fill([this](const Point3& p) { return noise.turbulence(p, turbulence); });
+
+            BakeStatistics stats;
+            stats.memoryBytes = bakedTurbulence.memoryBytes();
+
+            double absoluteErrorSum = 0.0;
+            double squaredErrorSum = 0.0;
+
+            // The error is measured at points from a stream of its own, so baking leaves the random
+            // numbers drawn after it (e.g. by the rest of a scene) unchanged.
+            RandomGenerator errorGenerator;
+            errorGenerator.seed(0);
+            std::swap(threadRandomGenerator, errorGenerator);
+
+            for (int i = 0; i < errorSamples; i++)
+            {
+                Point3 p = Point3
+                (
+                    randomFloat(region.x.min, region.x.max),
+                    randomFloat(region.y.min, region.y.max),
+                    randomFloat(region.z.min, region.z.max)
+                );
+
+                float error = std::fabs(bakedTurbulence.sample(p) - noise.turbulence(p, turbulence));
+
+                absoluteErrorSum += error;
+                squaredErrorSum += error * error;
+                stats.maxAbsoluteError = std::fmax(stats.maxAbsoluteError, error);
+            }
+
+            std::swap(threadRandomGenerator, errorGenerator);
+
+            if (errorSamples > 0)
+            {
+                stats.meanAbsoluteError = float(absoluteErrorSum / errorSamples);
+                stats.rmsError = float(std::sqrt(squaredErrorSum / errorSamples));
+            }
+
+            return stats;
+        }
+
+        bool isBaked() const { return !bakedTurbulence.isEmpty(); }
 
         Color value(float u, float v, const Point3& p) const override
         {
-            return Color(0.5f) * (1 + std::sin(scale * p.z() + 10.0f * noise.turbulence(p, turbulence)));
+            float turbulenceValue = (isBaked() && bakedTurbulence.contains(p))
+                                  ? bakedTurbulence.sample(p)
+                                  : noise.turbulence(p, turbulence);
+
+            return Color(0.5f) * (1 + std::sin(scale * p.z() + 10.0f * turbulenceValue));
         }
 };
 
@@ -2,6 +2,7 @@
 #define UTILITIES_H
 
 #include <cmath>
+#include <cstdint>
 #include <cstdlib>
 #include <iostream>
 #include <limits>
@@ -16,17 +17,75 @@ using std::shared_ptr;
 
 const float infinity = std::numeric_limits<float>::infinity();
 const float pi = 3.1415926535;
+const float oneMinusEpsilon = 0.99999994f;  // Largest float below 1
 
 // Utils
 
 inline float deg2rad(float deg) { return deg * pi / 180.0f; }
 
-inline float randomFloat() { return std::rand() / (RAND_MAX + 1.0f); }
+// Small, fast generator with 64-bit state (PCG32), so every thread can own one.
+class RandomGenerator
+{
+    private:
+        uint64_t state = 0x853c49e6748fea9bull;
+        uint64_t increment = 0xda3e39cb94b95bdbull;
+
+
+    public:
+        /// @brief Restart the generator on the stream selected by sequence.
+        void seed(uint64_t sequence, uint64_t offset = 0)
+        {
+            state = 0;
+            increment = (sequence << 1) | 1;
+            nextUInt();
+            state += offset;
+            nextUInt();
+        }
+
+        uint32_t nextUInt()
+        {
+            uint64_t oldState = state;
+            state = oldState * 0x5851f42d4c957f2dull + increment;
+
+            uint32_t xorShifted = uint32_t(((oldState >> 18) ^ oldState) >> 27);
+            uint32_t rotation = uint32_t(oldState >> 59);
+
+            return (xorShifted >> rotation) | (xorShifted << ((~rotation + 1) & 31));
+        }
+};
+
+// Each thread draws from its own generator; renders reseed it per pixel sample.
+inline thread_local RandomGenerator threadRandomGenerator;
+
+inline void seedRandom(uint64_t sequence) { threadRandomGenerator.seed(sequence); }
+
+inline float randomFloat() { return (threadRandomGenerator.nextUInt() >> 8) * (1.0f / 16777216.0f); }
 
 inline float randomFloat(float min, float max) { return min + (max-min) * randomFloat(); }
 
 inline int randomInt(int min, int max) { return int(randomFloat(min, max + 1)); }
 
+// 64-bit finalizer that spreads every input bit over the whole output.
+inline uint64_t mixBits(uint64_t v)
+{
+    v ^= (v >> 31);
+    v *= 0x7fb5d329728ea185ull;
+    v ^= (v >> 27);
+    v *= 0x81dadef4bc2dd44dull;
+    v ^= (v >> 33);
+
+    return v;
+}
+
+inline uint64_t hashCombine(uint64_t seed, uint64_t value)
+{
+    return mixBits(seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2)));
+}
+
+/// @brief Uniform float in [0, 1) from the top bits of a hash, for random values that are
+///        computed from counters (pixel, sample, dimension) instead of drawn from a stream.
+inline float hashToFloat(uint64_t hash) { return float(hash >> 40) * (1.0f / 16777216.0f); }
+
 // Common headers
 
 #include "Color.h"
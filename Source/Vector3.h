@@ -201,6 +201,74 @@ inline Vector3 randomInUnitDisk()
     }
 }
 
+/// @brief Map a point of the unit square to a point inside the unit disk (concentric mapping).
+/// @param u Sample point in [0, 1)^2, stored in x and y.
+/// @return new vector inside a unit disk.
+inline Vector3 sampleUniformDisk(const Vector3& u)
+{
+    float offsetX = 2.0f * u.x() - 1.0f;
+    float offsetY = 2.0f * u.y() - 1.0f;
+
+    if (offsetX == 0.0f && offsetY == 0.0f)
+        return Vector3(0);
+
+    float r;
+    float theta;
+
+    if (std::fabs(offsetX) > std::fabs(offsetY))
+    {
+        r = offsetX;
+        theta = (pi / 4.0f) * (offsetY / offsetX);
+    }
+    else
+    {
+        r = offsetY;
+        theta = (pi / 2.0f) - (pi / 4.0f) * (offsetX / offsetY);
+    }
+
+    return Vector3(r * std::cos(theta), r * std::sin(theta), 0);
+}
+
+/// @brief Map a point of the unit square to a direction on the unit sphere.
+/// @param u Sample point in [0, 1)^2, stored in x and y.
+/// @return new vector with uniformly distributed direction and magnitude of 1.
+inline Vector3 sampleUniformSphere(const Vector3& u)
+{
+    float z = 1.0f - 2.0f * u.x();
+    float r = std::sqrt(std::fmax(0.0f, 1.0f - z * z));
+    float phi = 2.0f * pi * u.y();
+
+    return Vector3(r * std::cos(phi), r * std::sin(phi), z);
+}
+
+/// @brief Build two unit vectors that form an orthonormal basis together with the normal
+///        (branchless, Duff et al.).
+inline void orthonormalBasis(const Vector3& normal, Vector3& tangent, Vector3& bitangent)
+{
+    float sign = std::copysign(1.0f, normal.z());
+    float a = -1.0f / (sign + normal.z());
+    float b = normal.x() * normal.y() * a;
+
+    tangent = Vector3(1.0f + sign * normal.x() * normal.x() * a, sign * b, -sign * normal.x());
+    bitangent = Vector3(b, sign + normal.y() * normal.y() * a, -normal.y());
+}
+
+/// @brief Map a point of the unit square to a cosine-weighted direction around a normal.
+/// @param normal The unit normal of the surface.
+/// @param u Sample point in [0, 1)^2, stored in x and y.
+/// @return new unit vector in the hemisphere of the normal.
+inline Vector3 sampleCosineHemisphere(const Vector3& normal, const Vector3& u)
+{
+    Vector3 d = sampleUniformDisk(u);
+    float z = std::sqrt(std::fmax(0.0f, 1.0f - d.x() * d.x() - d.y() * d.y()));
+
+    Vector3 tangent;
+    Vector3 bitangent;
+    orthonormalBasis(normal, tangent, bitangent);
+
+    return d.x() * tangent + d.y() * bitangent + z * normal;
+}
+
 
 inline Vector3 reflect(const Vector3& v, const Vector3& normal)
 {
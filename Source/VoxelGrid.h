@@ -0,0 +1,112 @@
+#ifndef VOXELGRID_H
+#define VOXELGRID_H
+
+#include "AAlignedBBox.h"
+
+#include <algorithm>
+#include <vector>
+
+
+// Regular 3D grid of scalar values spanning a bounding box. Values are stored at
+// the lattice points, so a grid of resolution n has n points (n - 1 cells) per axis.
+class VoxelGrid
+{
+    private:
+        AAlignedBBox bounds;
+        int resX = 0;
+        int resY = 0;
+        int resZ = 0;
+        Vector3 worldToGrid;
+        std::vector<float> values;
+
+
+    public:
+        VoxelGrid() {}
+
+        VoxelGrid(const AAlignedBBox& bounds, int resX, int resY, int resZ)
+        : bounds(bounds), resX(resX < 2 ? 2 : resX), resY(resY < 2 ? 2 : resY), resZ(resZ < 2 ? 2 : resZ)
+        {
+            worldToGrid = Vector3
+            (
+                (this->resX - 1) / bounds.x.size(),
+                (this->resY - 1) / bounds.y.size(),
+                (this->resZ - 1) / bounds.z.size()
+            );
+
+            values = std::vector<float>(size_t(this->resX) * this->resY * this->resZ, 0.0f);
+        }
+
+        VoxelGrid(const AAlignedBBox& bounds, int resolution)
+        : VoxelGrid(bounds, resolution, resolution, resolution) {}
+
+
+        /// @brief Evaluate f at every lattice point and store the result.
+        /// @param f Callable taking a Point3 and returning a float.
+        template <typename F>
+        void fill(F f)
+        {
+            for (int k = 0; k < resZ; k++)
+                for (int j = 0; j < resY; j++)
+                    for (int i = 0; i < resX; i++)
+                        at(i, j, k) = f(latticePoint(i, j, k));
+        }
+
+        Point3 latticePoint(int i, int j, int k) const
+        {
+            return Point3
+            (
+                bounds.x.min + i / worldToGrid.x(),
+                bounds.y.min + j / worldToGrid.y(),
+                bounds.z.min + k / worldToGrid.z()
+            );
+        }
+
+        float& at(int i, int j, int k) { return values[(size_t(k) * resY + j) * resX + i]; }
+        float at(int i, int j, int k) const { return values[(size_t(k) * resY + j) * resX + i]; }
+
+        bool contains(const Point3& p) const
+        {
+            return bounds.x.contains(p.x()) && bounds.y.contains(p.y()) && bounds.z.contains(p.z());
+        }
+
+        /// @brief Trilinearly interpolate the grid at p. Points outside the bounds are clamped to the border.
+        float sample(const Point3& p) const
+        {
+            float gx = Interval(0, resX - 1).clamp((p.x() - bounds.x.min) * worldToGrid.x());
+            float gy = Interval(0, resY - 1).clamp((p.y() - bounds.y.min) * worldToGrid.y());
+            float gz = Interval(0, resZ - 1).clamp((p.z() - bounds.z.min) * worldToGrid.z());
+
+            int i = std::min(int(gx), resX - 2);
+            int j = std::min(int(gy), resY - 2);
+            int k = std::min(int(gz), resZ - 2);
+
+            float fx = gx - i;
+            float fy = gy - j;
+            float fz = gz - k;
+
+            float c00 = at(i, j, k)         * (1 - fx) + at(i + 1, j, k)         * fx;
+            float c10 = at(i, j + 1, k)     * (1 - fx) + at(i + 1, j + 1, k)     * fx;
+            float c01 = at(i, j, k + 1)     * (1 - fx) + at(i + 1, j, k + 1)     * fx;
+            float c11 = at(i, j + 1, k + 1) * (1 - fx) + at(i + 1, j + 1, k + 1) * fx;
+
+            float c0 = c00 * (1 - fy) + c10 * fy;
+            float c1 = c01 * (1 - fy) + c11 * fy;
+
+            return c0 * (1 - fz) + c1 * fz;
+        }
+
+        Vector3 cellSize() const
+        {
+            return Vector3(1.0f / worldToGrid.x(), 1.0f / worldToGrid.y(), 1.0f / worldToGrid.z());
+        }
+
+        const AAlignedBBox& boundingBox() const { return bounds; }
+        int resolutionX() const { return resX; }
+        int resolutionY() const { return resY; }
+        int resolutionZ() const { return resZ; }
+        bool isEmpty() const { return values.empty(); }
+        size_t memoryBytes() const { return values.size() * sizeof(float); }
+};
+
+
+#endif
@@ -0,0 +1,345 @@
+#ifndef WAVEFRONT_H
+#define WAVEFRONT_H
+
+#include "Hittable.h"
+#include "Material.h"
+#include "ProgressReporter.h"
+#include "Sampler.h"
+
+#include <algorithm>
+#include <vector>
+
+
+// State of a batch of paths in structure-of-arrays layout. Besides its ray and throughput, every
+// path remembers its camera sample (pixel, sample index, sampler dimension) and random stream,
+// so it can be continued at any time and in any order with exactly the values it would get
+// when traced on its own.
+class PathQueue
+{
+    public:
+        std::vector<float> originX;
+        std::vector<float> originY;
+        std::vector<float> originZ;
+        std::vector<float> directionX;
+        std::vector<float> directionY;
+        std::vector<float> directionZ;
+        std::vector<float> time;
+        std::vector<float> throughputR;
+        std::vector<float> throughputG;
+        std::vector<float> throughputB;
+        std::vector<int> pathID;
+        std::vector<int> pixelX;
+        std::vector<int> pixelY;
+        std::vector<int> sampleIndex;
+        std::vector<int> dimension;
+        std::vector<RandomGenerator> generators;
+
+
+        size_t size() const { return pathID.size(); }
+
+        void clear()
+        {
+            for (std::vector<float>* values : { &originX, &originY, &originZ, &directionX, &directionY, &directionZ,
+                                                &time, &throughputR, &throughputG, &throughputB })
+                values->clear();
+
+            for (std::vector<int>* values : { &pathID, &pixelX, &pixelY, &sampleIndex, &dimension })
+                values->clear();
+
+            generators.clear();
+        }
+
+        void push(const Ray& ray, const Color& throughput, int id, int x, int y, int sample, int nextDimension,
+                  const RandomGenerator& generator)
+        {
+            originX.push_back(ray.origin().x());
+            originY.push_back(ray.origin().y());
+            originZ.push_back(ray.origin().z());
+            directionX.push_back(ray.direction().x());
+            directionY.push_back(ray.direction().y());
+            directionZ.push_back(ray.direction().z());
+            time.push_back(ray.time());
+            throughputR.push_back(throughput.x());
+            throughputG.push_back(throughput.y());
+            throughputB.push_back(throughput.z());
+            pathID.push_back(id);
+            pixelX.push_back(x);
+            pixelY.push_back(y);
+            sampleIndex.push_back(sample);
+            dimension.push_back(nextDimension);
+            generators.push_back(generator);
+        }
+
+        /// @brief Replace the contents with the paths order[0], order[1], ... of another queue.
+        void gather(const PathQueue& other, const std::vector<uint32_t>& order)
+        {
+            auto gatherArray = [&](auto& values, const auto& otherValues)
+            {
+                values.resize(order.size());
+
+                for (size_t i = 0; i < order.size(); i++)
+                    values[i] = otherValues[order[i]];
+            };
+
+            gatherArray(originX, other.originX);
+            gatherArray(originY, other.originY);
+            gatherArray(originZ, other.originZ);
+            gatherArray(directionX, other.directionX);
+            gatherArray(directionY, other.directionY);
+            gatherArray(directionZ, other.directionZ);
+            gatherArray(time, other.time);
+            gatherArray(throughputR, other.throughputR);
+            gatherArray(throughputG, other.throughputG);
+            gatherArray(throughputB, other.throughputB);
+            gatherArray(pathID, other.pathID);
+            gatherArray(pixelX, other.pixelX);
+            gatherArray(pixelY, other.pixelY);
+            gatherArray(sampleIndex, other.sampleIndex);
+            gatherArray(dimension, other.dimension);
+            gatherArray(generators, other.generators);
+        }
+
+        Ray ray(size_t i) const
+        {
+            return Ray(Point3(originX[i], originY[i], originZ[i]), Vector3(directionX[i], directionY[i], directionZ[i]), time[i]);
+        }
+
+        Color throughput(size_t i) const { return Color(throughputR[i], throughputG[i], throughputB[i]); }
+};
+
+
+// Breadth-first ("wavefront") path tracer. Instead of following one path to its end, it
+// advances a whole batch of paths by one bounce per iteration, in stages:
+//   sort:   order the rays by direction octant, then by origin along a Morton curve,
+//   extend: intersect all rays with the world, the camera rays in packets of neighbours,
+//   shade:  evaluate emission and scattering for all hits, grouped by material,
+// and keeps the surviving paths for the next iteration. Each stage runs one kind of work over
+// many rays, so traversal and material code stay hot in the caches. There is no light sampling
+// in this renderer, so there is no shadow ray stage.
+class WavefrontIntegrator
+{
+    private:
+        PathQueue paths;
+        PathQueue sortedPaths;
+        std::vector<Color> radiance;
+        std::vector<HitRecord> records;
+        std::vector<bool> hits;
+        std::vector<const Material*> materials;
+        std::vector<uint64_t> sortKeys;
+        std::vector<uint32_t> order;
+        AAlignedBBox sceneBounds;
+
+
+        /// @brief Spread the lower 10 bits of v so there are two zero bits between each of them.
+        static uint32_t expandBits(uint32_t v)
+        {
+            v = (v | (v << 16)) & 0x030000ff;
+            v = (v | (v << 8)) & 0x0300f00f;
+            v = (v | (v << 4)) & 0x030c30c3;
+            v = (v | (v << 2)) & 0x09249249;
+
+            return v;
+        }
+
+        /// @brief Position of value within the scene bounds along an axis, in 9 bits.
+        uint32_t quantize(float value, int axis) const
+        {
+            const Interval& bounds = sceneBounds.axisInterval(axis);
+            float relative = (bounds.size() > 0.0f) ? (value - bounds.min) / bounds.size() : 0.0f;
+
+            return uint32_t(std::clamp(relative, 0.0f, 1.0f) * 511.0f);
+        }
+
+        /// @brief Order sortKeys[i] = (key << 32) | i by key and read the indices back into order.
+        ///        The index in the low bits keeps paths with equal keys in their current order.
+        void sortIndices()
+        {
+            std::sort(sortKeys.begin(), sortKeys.end());
+
+            order.resize(sortKeys.size());
+
+            for (size_t i = 0; i < sortKeys.size(); i++)
+                order[i] = uint32_t(sortKeys[i]);
+        }
+
+        void sortRays()
+        {
+            size_t count = paths.size();
+
+            sortKeys.resize(count);
+
+            for (size_t i = 0; i < count; i++)
+            {
+                uint64_t octant = (paths.directionX[i] < 0.0f ? 1 : 0) |
+                                  (paths.directionY[i] < 0.0f ? 2 : 0) |
+                                  (paths.directionZ[i] < 0.0f ? 4 : 0);
+
+                uint64_t morton = expandBits(quantize(paths.originX[i], 0)) |
+                                  (expandBits(quantize(paths.originY[i], 1)) << 1) |
+                                  (expandBits(quantize(paths.originZ[i], 2)) << 2);
+
+                sortKeys[i] = (((octant << 27) | morton) << 32) | i;
+            }
+
+            // Rays with equal keys (e.g. camera rays) keep their image order.
+            sortIndices();
+
+            sortedPaths.gather(paths, order);
+            std::swap(paths, sortedPaths);
+        }
+
+        /// @brief Intersect every path's ray with the world.
+        /// @param usePackets Trace neighbouring rays as packets; only worth it for coherent rays.
+        void extend(const Hittable& world, bool usePackets)
+        {
+            size_t count = paths.size();
+
+            records.resize(count);
+            hits.assign(count, false);
+            threadRayCount += count;
+
+            if (!usePackets)
+            {
+                for (size_t i = 0; i < count; i++)
+                {
+                    std::swap(threadRandomGenerator, paths.generators[i]);
+                    hits[i] = world.hit(paths.ray(i), Interval(0.0001f, infinity), records[i]);
+                    std::swap(threadRandomGenerator, paths.generators[i]);
+                }
+
+                return;
+            }
+
+            RayPacket packet;
+            bool active[maxPacketSize];
+            bool packetHits[maxPacketSize];
+            float closest[maxPacketSize];
+
+            for (size_t first = 0; first < count; first += maxPacketSize)
+            {
+                size_t last = std::min(first + maxPacketSize, count);
+
+                packet.clear();
+
+                for (size_t i = first; i < last; i++)
+                    packet.add(paths.ray(i), paths.generators[i]);
+
+                packet.finalize();
+
+                for (int k = 0; k < packet.size; k++)
+                {
+                    active[k] = true;
+                    packetHits[k] = false;
+                    closest[k] = infinity;
+                }
+
+                world.hitPacket(packet, active, 0.0001f, closest, &records[first], packetHits);
+
+                for (int k = 0; k < packet.size; k++)
+                {
+                    hits[first + k] = packetHits[k];
+                    paths.generators[first + k] = packet.generators[k];
+                }
+            }
+        }
+
+        void shade(const Color& backgroundColor, Sampler& sampler)
+        {
+            size_t count = paths.size();
+
+            materials.clear();
+            sortKeys.clear();
+
+            // Group the hits by material, so consecutive paths run the same scatter code.
+            for (size_t i = 0; i < count; i++)
+            {
+                if (!hits[i])
+                {
+                    radiance[paths.pathID[i]] += paths.throughput(i) * backgroundColor;
+                    continue;
+                }
+
+                const Material* material = records[i].mat.get();
+                auto found = std::find(materials.begin(), materials.end(), material);
+
+                if (found == materials.end())
+                    found = materials.insert(found, material);
+
+                sortKeys.push_back((uint64_t(found - materials.begin()) << 32) | i);
+            }
+
+            sortIndices();
+
+            sortedPaths.clear();
+
+            for (uint32_t i : order)
+            {
+                const HitRecord& record = records[i];
+                Ray ray = paths.ray(i);
+                Color throughput = paths.throughput(i);
+
+                std::swap(threadRandomGenerator, paths.generators[i]);
+                sampler.startPixelSample(paths.pixelX[i], paths.pixelY[i], paths.sampleIndex[i]);
+                sampler.setDimension(paths.dimension[i]);
+
+                Ray scattered;
+                Color attenuation;
+
+                radiance[paths.pathID[i]] += throughput * record.mat->emitted(record.u, record.v, record.p);
+
+                bool scatters = record.mat->scatter(ray, record, attenuation, scattered, sampler);
+
+                std::swap(threadRandomGenerator, paths.generators[i]);
+
+                if (scatters)
+                    sortedPaths.push(scattered, throughput * attenuation, paths.pathID[i], paths.pixelX[i], paths.pixelY[i],
+                                     paths.sampleIndex[i], sampler.currentDimension(), paths.generators[i]);
+            }
+
+            std::swap(paths, sortedPaths);
+        }
+
+
+    public:
+        /// @brief Queue a camera path. Its result is pathRadiance()[i] for the i-th path added.
+        /// @param nextDimension Sampler dimension after the camera ray was generated.
+        /// @param generator State of the random stream after the camera ray was generated.
+        void addPath(const Ray& ray, int x, int y, int sampleIndex, int nextDimension, const RandomGenerator& generator)
+        {
+            paths.push(ray, Color(1.0f), int(radiance.size()), x, y, sampleIndex, nextDimension, generator);
+            radiance.push_back(Color(0.0f));
+        }
+
+        size_t pathCount() const { return radiance.size(); }
+
+        /// @brief Trace all queued paths for up to maxDepth rays each.
+        void trace(const Hittable& world, int maxDepth, const Color& backgroundColor, Sampler& sampler)
+        {
+            sceneBounds = world.boundingBox();
+
+            for (int depth = 0; depth < maxDepth && paths.size() > 0; depth++)
+            {
+                sortRays();
+
+                // Camera rays are coherent; after a diffuse bounce, packets would mostly carry a few active rays.
+                extend(world, depth == 0);
+                shade(backgroundColor, sampler);
+            }
+
+            // Paths still alive reached the depth limit and receive no more light.
+            paths.clear();
+        }
+
+        /// @return The color of every path traced so far, in the order they were added.
+        const std::vector<Color>& pathRadiance() const { return radiance; }
+
+        /// @brief Forget all paths, keeping the allocated memory for the next batch.
+        void clear()
+        {
+            paths.clear();
+            radiance.clear();
+        }
+};
+
+
+#endif
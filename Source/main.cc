@@ -3,17 +3,32 @@
 #include "BVH.h"
 #include "Camera.h"
 #include "ConstantMedium.h"
+#include "DistributedRender.h"
+#include "HeterogeneousMedium.h"
 #include "Hittable.h"
 #include "HittableList.h"
+#include "ImageCompare.h"
 #include "Material.h"
 #include "Primitives.h"
 #include "Texture.h"
 
+#include <sstream>
+
 
 using Scene = HittableList;
+using RenderFunction = void (Camera::*)(const Hittable&);
+
+
+// A scene's world and camera, plus the render mode it is meant to be rendered with.
+struct SceneSetup
+{
+    Scene world;
+    Camera cam;
+    RenderFunction render;
+};
 
 
-void finalRenderBook1()
+SceneSetup finalRenderBook1()
 {
     Scene finalRender;
 
@@ -87,11 +102,11 @@ void finalRenderBook1()
     
     finalRender = HittableList(make_shared<BVHNode>(finalRender));
 
-    cam.render(finalRender);
+    return { finalRender, cam, &Camera::render };
 }
 
 
-void experimentalScene()
+SceneSetup experimentalScene()
 {
 
     // Materials
@@ -135,11 +150,11 @@ void experimentalScene()
 
     cam.backgroundColor = Color(0.75f, 0.8f, 1);
 
-    cam.render(world);
+    return { world, cam, &Camera::render };
 }
 
 
-void checkeredSpheres()
+SceneSetup checkeredSpheres()
 {
     Scene world;
 
@@ -166,11 +181,11 @@ void checkeredSpheres()
 
     world = Scene(make_shared<BVHNode>(world));
 
-    cam.render(world);
+    return { world, cam, &Camera::render };
 }
 
 
-void earthSphere()
+SceneSetup earthSphere()
 {
     auto earthTexture = make_shared<ImageTexture>("EarthUV.png");
     auto earthSurface = make_shared<LambertianMaterial>(earthTexture);
@@ -190,11 +205,11 @@ void earthSphere()
 
     cam.defocusAngle = 0;
 
-    cam.render(Scene(globe));
+    return { Scene(globe), cam, &Camera::render };
 }
 
 
-void perlinSpheres()
+SceneSetup perlinSpheres()
 {
     Scene world;
 
@@ -219,11 +234,11 @@ void perlinSpheres()
 
     cam.backgroundColor = Color(0.75f, 0.8f, 1);
 
-    cam.render(world);
+    return { world, cam, &Camera::render };
 }
 
 
-void quads()
+SceneSetup quads()
 {
     Scene world;
 
@@ -257,11 +272,11 @@ void quads()
 
     cam.backgroundColor = Color(0.75f, 0.8f, 1);
 
-    cam.render(world);
+    return { world, cam, &Camera::render };
 }
 
 
-void tris()
+SceneSetup tris()
 {
     Scene world;
 
@@ -295,11 +310,11 @@ void tris()
 
     cam.backgroundColor = Color(0.75f, 0.8f, 1);
 
-    cam.render(world);
+    return { world, cam, &Camera::render };
 }
 
 
-void simpleLight()
+SceneSetup simpleLight()
 {
     Scene world;
 
@@ -332,11 +347,11 @@ void simpleLight()
 
     cam.defocusAngle = 0;
 
-    cam.render(world);
+    return { world, cam, &Camera::render };
 }
 
 
-void cornellBox()
+SceneSetup cornellBox()
 {
     Scene world;
 
@@ -386,11 +401,11 @@ void cornellBox()
 
     cam.defocusAngle = 0;
 
-    cam.render(world);
+    return { world, cam, &Camera::render };
 }
 
 
-void cornellBoxSmoke()
+SceneSetup cornellBoxSmoke()
 {
     Scene world;
     
@@ -432,11 +447,67 @@ void cornellBoxSmoke()
     
     cam.defocusAngle = 0;
     
-    cam.render(world);
+    cam.samplesPerPass = 25;
+    cam.snapshotInterval = 30.0f;
+    cam.snapshotFilename = "cornellBoxSmoke.snapshot.ppm";
+    
+    return { world, cam, &Camera::progressiveRender };
 }
 
 
-void finalRenderBook2()
+SceneSetup cornellBoxNoiseSmoke()
+{
+    Scene world;
+    
+    auto red   = make_shared<LambertianMaterial>(Color(.65, .05, .05));
+    auto white = make_shared<LambertianMaterial>(Color(.73, .73, .73));
+    auto green = make_shared<LambertianMaterial>(Color(.12, .45, .15));
+    auto light = make_shared<DiffuseLightMaterial>(Color(7, 7, 7));
+    
+    world.add(make_shared<Quad>(Point3(555,0,0), Vector3(0,555,0), Vector3(0,0,555), green));
+    world.add(make_shared<Quad>(Point3(0,0,0), Vector3(0,555,0), Vector3(0,0,555), red));
+    world.add(make_shared<Quad>(Point3(113,554,127), Vector3(330,0,0), Vector3(0,0,305), light));
+    world.add(make_shared<Quad>(Point3(0,555,0), Vector3(555,0,0), Vector3(0,0,555), white));
+    world.add(make_shared<Quad>(Point3(0,0,0), Vector3(555,0,0), Vector3(0,0,555), white));
+    world.add(make_shared<Quad>(Point3(0,0,555), Vector3(555,0,0), Vector3(0,555,0), white));
+
+    // Smoke plume: turbulence baked into a density grid, denser towards the bottom
+    auto smokeNoise = make_shared<NoiseTexture>(0.02f, 7);
+    auto smokeBounds = make_shared<Sphere>(Point3(278, 230, 278), 180, white);
+    VoxelGrid smokeDensity = VoxelGrid(smokeBounds->boundingBox(), 96);
+
+    smokeDensity.fill([&](const Point3& p)
+    {
+        float falloff = Interval(0, 1).clamp((410 - p.y()) / 360);
+        float plume = smokeNoise->value(0, 0, 0.02f * p).x();
+
+        return 0.05f * falloff * plume * plume;
+    });
+
+    world.add(make_shared<HeterogeneousMedium>(smokeBounds, smokeDensity, Color(0.8f), 8));
+
+    world = Scene(make_shared<BVHNode>(world));
+    
+    Camera cam;
+    
+    cam.aspectRatio      = 1.0;
+    cam.imageWidth       = 320;
+    cam.samplesPerPixel = 500;
+    cam.maxDepth         = 50;
+    cam.backgroundColor        = Color(0,0,0);
+    
+    cam.verticalFOV     = 40;
+    cam.lookfrom = Point3(278, 278, -800);
+    cam.lookat   = Point3(278, 278, 0);
+    cam.vup      = Vector3(0,1,0);
+    
+    cam.defocusAngle = 0;
+    
+    return { world, cam, &Camera::multithreadedRender };
+}
+
+
+SceneSetup finalRenderBook2()
 {
     HittableList groundBoxes;
 
@@ -494,6 +565,8 @@ void finalRenderBook2()
 
     // Noise sphere
     auto noiseMat = make_shared<NoiseTexture>(10, 4);
+    noiseMat->bake(AAlignedBBox(Point3(1, 9, 5), Point3(5, 13, 9)), 96);
+
     world.add(make_shared<Sphere>(Point3(3, 11, 7), 2, make_shared<LambertianMaterial>(noiseMat)));
 
     // Earth sphere
@@ -587,11 +660,16 @@ void finalRenderBook2()
     cam.backgroundColor = Color(0.005f);
     cam.defocusAngle = 0;
 
-    cam.multithreadedRender(world);
+    cam.samplesPerPass = 20;
+    cam.snapshotInterval = 60.0f;
+    cam.snapshotFilename = "finalRenderBook2.snapshot.ppm";
+    cam.checkpointFilename = "finalRenderBook2.checkpoint";
+
+    return { world, cam, &Camera::progressiveRender };
 }
 
 
-void primitiveShowcase()
+SceneSetup primitiveShowcase()
 {
     Scene world;
 
@@ -618,10 +696,8 @@ void primitiveShowcase()
     hex = make_shared<BVHNode>(hex);
     world.add(hex);
     
-    // disk (100-gon)
-    shared_ptr<Hittable> disk = NGon(32, Point3(7, 1, -3), 1, redMat);
-    disk = make_shared<BVHNode>(disk);
-    world.add(disk);
+    // Disk
+    world.add(make_shared<Disk>(Point3(7, 1, -3), Vector3(0, 1, 0), 1, redMat));
 
     // Sphere
     world.add(make_shared<Sphere>(Point3(-7, 1.5f, 3), 1, redMat));
@@ -637,9 +713,7 @@ void primitiveShowcase()
     world.add(pyramid);
 
     // Cylinder
-    shared_ptr<Hittable> cylinder = NPrism(32, Point3(7, 0.5f, 3), 1, 2, redMat);
-    cylinder = make_shared<BVHNode>(cylinder);
-    world.add(cylinder);
+    world.add(make_shared<Cylinder>(Point3(7, 0.5f, 3), Vector3(0, 1, 0), 1, 2, redMat));
 
     world = Scene(make_shared<BVHNode>(world));
 
@@ -659,21 +733,567 @@ void primitiveShowcase()
     cam.defocusAngle = 0;
     cam.backgroundColor = Color(0.4f, 0.6f, 0.9f);
 
-    cam.render(world);
+    return { world, cam, &Camera::render };
+}
+
+
+SceneSetup bouncingSpheres()
+{
+    Scene world;
+
+    auto checkerTex = make_shared<CheckerTexture>(0.32f, Color(0.2f, 0.3f, 0.1f), Color(0.9f));
+    world.add(make_shared<Sphere>(Point3(0, -1000, 0), 1000, make_shared<LambertianMaterial>(checkerTex)));
+
+    for (int a = -11; a < 11; a++)
+    {
+        for (int b = -11; b < 11; b++)
+        {
+            float randomMat = randomFloat();
+            Point3 center = Point3(a + 0.9f * randomFloat(), 0.2f, b + 0.9f * randomFloat());
+
+            if ((center - Point3(4, 0.2f, 0)).magnitude() <= 0.9f)
+                continue;
+
+            if (randomMat < 0.8f)
+            {
+                // Diffuse spheres bounce up during the exposure.
+                Color albedo = Color::randomVector() * Color::randomVector();
+                Point3 endCenter = center + Vector3(0, randomFloat(0.0f, 0.5f), 0);
+                world.add(make_shared<Sphere>(center, endCenter, 0.2f, make_shared<LambertianMaterial>(albedo)));
+            }
+            else if (randomMat < 0.95f)
+            {
+                Color albedo = Color::randomVector(0.5f, 1.0f);
+                float fuzz = randomFloat(0.0f, 0.5f);
+                world.add(make_shared<Sphere>(center, 0.2f, make_shared<MetalMaterial>(albedo, fuzz)));
+            }
+            else
+            {
+                world.add(make_shared<Sphere>(center, 0.2f, make_shared<DielectricMaterial>(1.5f)));
+            }
+        }
+    }
+
+    world.add(make_shared<Sphere>(Point3(0, 1, 0), 1, make_shared<DielectricMaterial>(1.5f)));
+    world.add(make_shared<Sphere>(Point3(-4, 1, 0), 1, make_shared<LambertianMaterial>(Color(0.4f, 0.2f, 0.1f))));
+    world.add(make_shared<Sphere>(Point3(4, 1, 0), 1, make_shared<MetalMaterial>(Color(0.7f, 0.6f, 0.5f), 0.0f)));
+
+    world = Scene(make_shared<BVHNode>(world));
+
+
+    Camera cam;
+
+    cam.aspectRatio = 16.0f / 9.0f;
+    cam.imageWidth = 400;
+    cam.samplesPerPixel = 100;
+    cam.maxDepth = 50;
+
+    cam.verticalFOV = 20;
+    cam.lookfrom = Point3(13, 2, 3);
+    cam.lookat = Point3(0, 0, 0);
+    cam.vup = Vector3(0, 1, 0);
+
+    cam.defocusAngle = 0.6f;
+    cam.focusDistance = 10.0f;
+
+    cam.backgroundColor = Color(0.7f, 0.8f, 1);
+
+    return { world, cam, &Camera::render };
+}
+
+
+struct SceneEntry
+{
+    const char* name;
+    SceneSetup (*build)();
+};
+
+const SceneEntry scenes[] =
+{
+    { "finalRenderBook1",       finalRenderBook1 },
+    { "experimentalScene",      experimentalScene },
+    { "checkeredSpheres",       checkeredSpheres },
+    { "earthSphere",            earthSphere },
+    { "perlinSpheres",          perlinSpheres },
+    { "quads",                  quads },
+    { "tris",                   tris },
+    { "simpleLight",            simpleLight },
+    { "cornellBox",             cornellBox },
+    { "cornellBoxSmoke",        cornellBoxSmoke },
+    { "cornellBoxNoiseSmoke",   cornellBoxNoiseSmoke },
+    { "finalRenderBook2",       finalRenderBook2 },
+    { "primitiveShowcase",      primitiveShowcase },
+    { "bouncingSpheres",        bouncingSpheres },
+};
+
+/// @brief Build a scene from a fixed random stream, so every run and every process builds the same scene.
+SceneSetup buildScene(const SceneEntry& scene)
+{
+    seedRandom(0);
+
+    SceneSetup setup = scene.build();
+    setup.cam.sceneName = scene.name;
+
+    return setup;
+}
+
+
+// Regression check: every scene is rendered small, with few samples and a fixed seed, and
+// compared with a stored reference. Renders are deterministic, so on the platform the references
+// were made on they match exactly; the tolerances absorb floating point differences between
+// compilers and platforms while still catching changes to the image.
+struct RegressionSettings
+{
+    int     imageWidth      = 128;
+    int     samplesPerPixel = 32;
+    float   maxMeanFlip     = 0.02f;
+    float   maxFlipPercentile99 = 0.25f;
+    float   maxRmse         = 0.03f;
+};
+
+ImageBuffer renderRegressionImage(const SceneEntry& scene, const RegressionSettings& settings)
+{
+    SceneSetup setup = buildScene(scene);
+    setup.cam.imageWidth = settings.imageWidth;
+    setup.cam.samplesPerPixel = std::min(setup.cam.samplesPerPixel, settings.samplesPerPixel);
+    setup.cam.seed = 0;
+
+    std::vector<Color> pixels;
+    setup.cam.renderTile(setup.world, setup.cam.cropWindow(), pixels);
+
+    // Go through the regular image output, so the comparison sees exactly what a render writes.
+    std::stringstream image;
+    setup.cam.writeCropImage(image, pixels);
+
+    ImageBuffer result;
+    result.readPPM(image);
+
+    return result;
+}
+
+/// @brief Compare every scene with its reference in referenceDirectory, or write new references.
+/// @return The number of scenes that failed.
+int runRegression(const std::string& referenceDirectory, bool updateReferences)
+{
+    RegressionSettings settings;
+    int failures = 0;
+
+    std::filesystem::create_directories(referenceDirectory);
+
+    for (const SceneEntry& scene : scenes)
+    {
+        std::string referenceFilename = (std::filesystem::path(referenceDirectory) / (std::string(scene.name) + ".ppm")).string();
+
+        std::clog << std::left << std::setw(24) << std::setfill(' ') << scene.name << std::flush;
+
+        auto startTime = std::chrono::high_resolution_clock::now();
+        ImageBuffer image = renderRegressionImage(scene, settings);
+        std::chrono::duration<float> renderTime = std::chrono::high_resolution_clock::now() - startTime;
+
+        if (updateReferences)
+        {
+            bool written = image.writePPM(referenceFilename);
+            failures += written ? 0 : 1;
+
+            std::clog << (written ? "reference written" : "could not write reference") << " ("
+                      << std::fixed << std::setprecision(2) << renderTime.count() << " s)\n";
+            continue;
+        }
+
+        ImageBuffer reference;
+
+        if (!reference.readPPM(referenceFilename) ||
+            reference.imageWidth() != image.imageWidth() || reference.imageHeight() != image.imageHeight())
+        {
+            failures++;
+            std::clog << "FAILED: no matching reference '" << referenceFilename << "'\n";
+            continue;
+        }
+
+        ImageDifference difference = compareImages(image, reference);
+
+        bool passed = difference.meanFlip <= settings.maxMeanFlip &&
+                      difference.flipPercentile99 <= settings.maxFlipPercentile99 &&
+                      difference.rmse <= settings.maxRmse;
+
+        failures += passed ? 0 : 1;
+
+        std::clog << (passed ? "ok    " : "FAILED") << std::fixed << std::setprecision(4)
+                  << "  FLIP mean " << difference.meanFlip << ", 99% " << difference.flipPercentile99
+                  << ", max " << difference.maxFlip << "  RMSE " << difference.rmse
+                  << std::setprecision(2) << "  (" << renderTime.count() << " s)\n";
+    }
+
+    if (!updateReferences)
+        std::clog << (failures == 0 ? "All scenes match their references.\n" : "Some scenes differ from their references.\n");
+
+    return failures;
+}
+
+
+/// @brief Build BVHs over objectCount random small spheres with every build method and report
+///        build time and the resulting tree's SAH cost. With a BVH cache directory set, also time
+///        writing the tree to the cache and loading it back.
+void runBVHBenchmark(size_t objectCount, int threads)
+{
+    seedRandom(0);
+
+    std::vector<shared_ptr<Hittable>> objects;
+    auto mat = make_shared<LambertianMaterial>(Color(0.5f));
+
+    for (size_t i = 0; i < objectCount; i++)
+        objects.push_back(make_shared<Sphere>(Point3::randomVector(-100.0f, 100.0f), randomFloat(0.05f, 0.5f), mat));
+
+    std::clog << "BVH over " << objectCount << " spheres, " << threads << " threads\n";
+
+    struct BenchmarkEntry
+    {
+        const char* name;
+        BVHBuildMethod method;
+        int threads;
+    };
+
+    const BenchmarkEntry entries[] =
+    {
+        { "median",                 BVHBuildMethod::Median,         1 },
+        { "binned SAH",             BVHBuildMethod::BinnedSAH,      1 },
+        { "binned SAH, parallel",   BVHBuildMethod::BinnedSAH,      threads },
+        { "spatial splits",         BVHBuildMethod::SpatialSplits,  1 },
+    };
+
+    auto timeBuild = [&](const char* name, BVHBuildMethod method, int buildThreads)
+    {
+        auto startTime = std::chrono::high_resolution_clock::now();
+        BVHNode bvh(objects, method, buildThreads);
+        std::chrono::duration<float> buildTime = std::chrono::high_resolution_clock::now() - startTime;
+
+        std::clog << std::left << std::setw(24) << std::setfill(' ') << name << std::fixed
+                  << std::setprecision(3) << buildTime.count() << " s  SAH cost " << std::setprecision(2) << bvh.sahCost() << "\n";
+    };
+
+    std::string cacheDirectory = BVHNode::cacheDirectory;
+    BVHNode::cacheDirectory.clear();
+
+    for (const BenchmarkEntry& entry : entries)
+        timeBuild(entry.name, entry.method, entry.threads);
+
+    if (cacheDirectory.empty())
+        return;
+
+    // Remove only this tree's file, never the directory, which may hold anything: the first build
+    // then writes the file and the second one loads it.
+    BVHNode::cacheDirectory = cacheDirectory;
+    std::string cacheFilename = BVHNode::cacheFilename(objects);
+    std::error_code error;
+    std::filesystem::remove(cacheFilename, error);
+
+    timeBuild("binned SAH, cache write", BVHBuildMethod::BinnedSAH, threads);
+    timeBuild("cache load", BVHBuildMethod::BinnedSAH, threads);
+
+    std::filesystem::remove(cacheFilename, error);
+
+    // The loaded tree is gone again; if all its nodes were freed, nothing else holds on to the objects.
+    bool allFreed = std::all_of(objects.begin(), objects.end(), [](const shared_ptr<Hittable>& object) { return object.use_count() == 1; });
+
+    std::clog << (allFreed ? "The loaded tree freed all its nodes.\n" : "The loaded tree did NOT free all its nodes.\n");
+}
+
+
+/// @brief Animate objectCount cubes, each turning around the scene's center at its own speed and
+///        bouncing, for frameCount frames. Every frame, a DynamicBVH is updated and compared with a
+///        tree built from scratch: update and build times, the refitted tree's SAH cost relative to
+///        its last build, and whether both trees render the same image.
+void runRefitBenchmark(size_t objectCount, int frameCount)
+{
+    seedRandom(0);
+
+    struct AnimatedObject
+    {
+        shared_ptr<Translate> translate;
+        shared_ptr<RotateY> rotate;
+        Vector3 position;
+        float angle;
+        float angularSpeed;
+        float bouncePhase;
+    };
+
+    std::vector<AnimatedObject> animatedObjects;
+    HittableList objects;
+    auto mat = make_shared<LambertianMaterial>(Color(0.5f));
+
+    for (size_t i = 0; i < objectCount; i++)
+    {
+        AnimatedObject animated;
+        animated.position = Vector3(randomFloat(-50.0f, 50.0f), randomFloat(-5.0f, 5.0f), randomFloat(-50.0f, 50.0f));
+        animated.angle = randomFloat(0.0f, 360.0f);
+        animated.angularSpeed = randomFloat(0.9f, 1.1f);
+        animated.bouncePhase = randomFloat(0.0f, 2.0f * pi);
+
+        // Rotating the translated cube turns it around the scene's center, like on a turntable. Cubes
+        // are hit with the same slab test as their bounds, so their hits stay inside their boxes and
+        // both trees find the same ones. Small spheres far from the camera do not: their quadratic
+        // loses precision and may report hits just outside the box, which looser boxes let through.
+        auto cube = Cube(Point3(0.0f), randomFloat(0.2f, 1.0f), mat);
+        animated.translate = make_shared<Translate>(cube, animated.position);
+        animated.rotate = make_shared<RotateY>(animated.translate, animated.angle);
+
+        animatedObjects.push_back(animated);
+        objects.add(animated.rotate);
+    }
+
+    Camera cam;
+    cam.aspectRatio = 16.0f / 9.0f;
+    cam.imageWidth = 96;
+    cam.samplesPerPixel = 4;
+    cam.maxDepth = 4;
+    cam.verticalFOV = 40;
+    cam.lookfrom = Point3(0, 60, 110);
+    cam.lookat = Point3(0, 0, 0);
+    cam.backgroundColor = Color(0.7f, 0.8f, 1.0f);
+
+    auto renderImage = [&cam](const Hittable& world)
+    {
+        std::vector<Color> pixels;
+        cam.renderTile(world, cam.cropWindow(), pixels);
+
+        return pixels;
+    };
+
+    using Clock = std::chrono::high_resolution_clock;
+
+    DynamicBVH dynamicBVH(objects);
+    std::chrono::duration<float> updateTotal(0.0f);
+    std::chrono::duration<float> buildTotal(0.0f);
+    int rebuilds = 0;
+    int mismatchedFrames = 0;
+
+    std::clog << "Animating " << objectCount << " cubes for " << frameCount << " frames\n";
+
+    for (int frame = 1; frame <= frameCount; frame++)
+    {
+        for (AnimatedObject& animated : animatedObjects)
+        {
+            float bounce = 0.5f * std::fabs(std::sin(0.3f * frame + animated.bouncePhase));
+
+            animated.translate->setOffset(animated.position + Vector3(0.0f, bounce, 0.0f));
+            animated.rotate->setAngle(animated.angle + frame * animated.angularSpeed);
+        }
+
+        auto startTime = Clock::now();
+        bool rebuilt = dynamicBVH.update();
+        std::chrono::duration<float> updateTime = Clock::now() - startTime;
+
+        startTime = Clock::now();
+        // Like the dynamic tree, fresh builds skip the cache, which would otherwise get a file per frame.
+        BVHNode freshBVH(objects.hittableObjects, BVHNode::defaultBuildMethod, std::max(1u, std::thread::hardware_concurrency()), false);
+        std::chrono::duration<float> buildTime = Clock::now() - startTime;
+
+        std::vector<Color> refittedImage = renderImage(dynamicBVH);
+        std::vector<Color> freshImage = renderImage(freshBVH);
+
+        bool imagesMatch = std::equal(refittedImage.begin(), refittedImage.end(), freshImage.begin(), freshImage.end(),
+                                      [](const Color& a, const Color& b) { return a.x() == b.x() && a.y() == b.y() && a.z() == b.z(); });
+
+        updateTotal += updateTime;
+        buildTotal += buildTime;
+        rebuilds += rebuilt ? 1 : 0;
+        mismatchedFrames += imagesMatch ? 0 : 1;
+
+        std::clog << "frame " << std::setw(4) << std::setfill(' ') << frame << "  " << (rebuilt ? "rebuild" : "refit  ")
+                  << std::fixed << std::setprecision(3) << "  update " << updateTime.count() << " s"
+                  << "  fresh build " << buildTime.count() << " s"
+                  << std::setprecision(2) << "  SAH cost ratio " << dynamicBVH.costRatio()
+                  << "  " << (imagesMatch ? "image matches" : "IMAGE DIFFERS") << "\n";
+    }
+
+    std::clog << std::fixed << std::setprecision(3) << "Updates: " << updateTotal.count() << " s with " << rebuilds
+              << " rebuilds, building every frame: " << buildTotal.count() << " s. "
+              << (mismatchedFrames == 0 ? "All frames match a fresh build.\n" : "Some frames differ from a fresh build.\n");
 }
 
 
-int main()
+void printUsage()
 {
-    //experimentalScene();
-    //earthSphere();
-    //perlinSpheres();
-    //quads();
-    //tris();
-    //simpleLight();
-    //cornellBox();
-    //cornellBoxSmoke();
-    finalRenderBook2();
-    //primitiveShowcase();
+    std::cerr << "Usage: main [--scene <name>] [--checkpoint <file>] [--resume] [--time-budget <seconds>]\n"
+              << "            [--crop <x0> <y0> <x1> <y1>] [--full-frame] [--coordinator <port>]\n"
+              << "            [--seed <n>] [--quiet] [--packets] [--wavefront] [--bvh-cache <directory>]\n"
+              << "            [--spatial-splits [<reference growth>]]\n"
+              << "       main --worker <host> <port> [--threads <count>] [--quiet]\n"
+              << "       main --regression [<reference directory>] [--update-references]\n"
+              << "       main --bvh-benchmark [<object count>] [--threads <count>] [--bvh-cache <directory>] [--frames <count>]\n"
+              << "Scenes:";
+
+    for (const SceneEntry& scene : scenes)
+        std::cerr << " " << scene.name;
+
+    std::cerr << "\n";
 }
 
+
+int main(int argc, char* argv[])
+{
+    std::string sceneName = "finalRenderBook2";
+    std::string checkpointFilename;
+    bool resume = false;
+    float timeBudget = 0.0f;
+    int crop[4] = { 0, 0, 0, 0 };
+    bool hasCrop = false;
+    bool fullFrame = false;
+    int coordinatorPort = 0;
+    std::string regressionDirectory;
+    bool updateReferences = false;
+    size_t benchmarkObjects = 0;
+    int benchmarkFrames = 0;
+    uint64_t seed = 0;
+    bool quiet = false;
+    bool packets = false;
+    bool wavefront = false;
+    std::string workerHost;
+    int workerPort = 0;
+    int workerThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+
+        if (arg == "--scene" && i + 1 < argc)
+            sceneName = argv[++i];
+        else if (arg == "--checkpoint" && i + 1 < argc)
+            checkpointFilename = argv[++i];
+        else if (arg == "--resume")
+            resume = true;
+        else if (arg == "--time-budget" && i + 1 < argc)
+            timeBudget = std::stof(argv[++i]);
+        else if (arg == "--crop" && i + 4 < argc)
+        {
+            for (int c = 0; c < 4; c++)
+                crop[c] = std::stoi(argv[++i]);
+
+            hasCrop = true;
+        }
+        else if (arg == "--full-frame")
+            fullFrame = true;
+        else if (arg == "--quiet")
+            quiet = true;
+        else if (arg == "--packets")
+            packets = true;
+        else if (arg == "--wavefront")
+            wavefront = true;
+        else if (arg == "--seed" && i + 1 < argc)
+            seed = std::stoull(argv[++i]);
+        else if (arg == "--coordinator" && i + 1 < argc)
+            coordinatorPort = std::stoi(argv[++i]);
+        else if (arg == "--worker" && i + 2 < argc)
+        {
+            workerHost = argv[++i];
+            workerPort = std::stoi(argv[++i]);
+        }
+        else if (arg == "--threads" && i + 1 < argc)
+            workerThreads = std::stoi(argv[++i]);
+        else if (arg == "--regression")
+            regressionDirectory = (i + 1 < argc && argv[i + 1][0] != '-') ? argv[++i] : "Renders/Reference";
+        else if (arg == "--update-references")
+            updateReferences = true;
+        else if (arg == "--bvh-cache" && i + 1 < argc)
+            BVHNode::cacheDirectory = argv[++i];
+        else if (arg == "--spatial-splits")
+        {
+            BVHNode::defaultBuildMethod = BVHBuildMethod::SpatialSplits;
+
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                BVHNode::spatialSplitGrowth = std::stof(argv[++i]);
+        }
+        else if (arg == "--frames" && i + 1 < argc)
+            benchmarkFrames = std::stoi(argv[++i]);
+        else if (arg == "--bvh-benchmark")
+            benchmarkObjects = (i + 1 < argc && argv[i + 1][0] != '-') ? std::stoull(argv[++i]) : 1000000;
+        else
+        {
+            printUsage();
+            return 1;
+        }
+    }
+
+    if (!regressionDirectory.empty())
+        return runRegression(regressionDirectory, updateReferences) == 0 ? 0 : 1;
+
+    if (benchmarkObjects > 0)
+    {
+        if (benchmarkFrames > 0)
+            runRefitBenchmark(benchmarkObjects, benchmarkFrames);
+        else
+            runBVHBenchmark(benchmarkObjects, workerThreads);
+
+        return 0;
+    }
+
+    // Workers build whatever scene the coordinator asks for.
+    if (!workerHost.empty())
+    {
+        auto buildNamedScene = [](const std::string& name, shared_ptr<Hittable>& world, Camera& cam)
+        {
+            for (const SceneEntry& scene : scenes)
+            {
+                if (name != scene.name)
+                    continue;
+
+                SceneSetup setup = buildScene(scene);
+                world = make_shared<Scene>(setup.world);
+                cam = setup.cam;
+
+                return true;
+            }
+
+            return false;
+        };
+
+        RenderWorker worker(workerHost, uint16_t(workerPort), buildNamedScene);
+        worker.quiet = quiet;
+
+        return worker.run(workerThreads) > 0 ? 0 : 1;
+    }
+
+    for (const SceneEntry& scene : scenes)
+    {
+        if (sceneName != scene.name)
+            continue;
+
+        SceneSetup setup = buildScene(scene);
+
+        if (!checkpointFilename.empty())
+            setup.cam.checkpointFilename = checkpointFilename;
+
+        setup.cam.resumeFromCheckpoint = resume;
+        setup.cam.writeFullFrame = fullFrame;
+        setup.cam.seed = seed;
+        setup.cam.quiet = quiet;
+        setup.cam.packetTracing = packets;
+        setup.cam.wavefront = wavefront;
+
+        if (hasCrop)
+            setup.cam.setCropWindowPixels(crop[0], crop[1], crop[2], crop[3]);
+
+        // A deadline only makes sense for pass-based rendering.
+        if (timeBudget > 0.0f)
+        {
+            setup.cam.timeBudget = timeBudget;
+            setup.render = &Camera::progressiveRender;
+        }
+
+        if (coordinatorPort > 0)
+        {
+            RenderCoordinator coordinator(sceneName, setup.cam, uint16_t(coordinatorPort));
+
+            return coordinator.render(std::cout) ? 0 : 1;
+        }
+
+        (setup.cam.*setup.render)(setup.world);
+
+        return 0;
+    }
+
+    std::cerr << "Unknown scene '" << sceneName << "'\n";
+    printUsage();
+
+    return 1;
+}